@@ -0,0 +1,258 @@
+//CompiledForest.h
+/**
+  *@file CompiledForest.h
+  *@brief Header file for the ForestCodeGenerator and CompiledForest classes, ahead-of-time compiled forest inference.
+  *Contain both declaraction and implementation
+*/
+
+#ifndef COMPILEDFOREST_H
+#define COMPILEDFOREST_H
+
+#include "RandomForest.h"
+#include <dlfcn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+  *@class ForestCodeGenerator
+  *@brief Turns trained trees into C++ source where every tree is a function of tests and jumps.
+  *
+*Each tree is written as a flat run of labelled statements rather than nested blocks, so deep trees never reach the
+*compiler's bracket nesting limit. Nodes follow in preorder: a split falls through to its left child and jumps to its
+*right child when the test fails.
+*Thresholds and leaf values are written as hexadecimal floating point literals, so the compiled code compares against
+*exactly the doubles the trees hold and returns exactly their leaf values. Tests keep the "x < threshold goes left" form,
+*so NaN features take the same path as DecisionTree::find_leaf.
+*The generated file exports a C interface that CompiledForest loads:
+*  int    lrp_num_trees(void);
+*  int    lrp_num_features(void);
+*  void   lrp_score(const double* x, int* positive_votes, double* value_sum);
+*/
+
+class ForestCodeGenerator {
+public:
+  /**
+    *@brief Writes the source of a shared object scoring @p trees.
+    *@param num_features Feature count of the forest (RandomForest::num_features), 0 if unknown.
+    */
+  static void generate(const vector<DecisionTree>& trees, ostream& out, size_t num_features = 0){
+    out << "// Generated by ForestCodeGenerator. Do not edit.\n";
+    out << "extern \"C\" {\n\n";
+    for (size_t t = 0; t < trees.size(); t++){
+      out << "static inline int lrp_tree_" << t << "(const double* x, double* value){\n";
+      emit_tree(trees[t].get_root(), out);
+      out << "}\n\n";
+    }
+    out << "int lrp_num_trees(void){ return " << trees.size() << "; }\n\n";
+    out << "int lrp_num_features(void){ return " << num_features << "; }\n\n";
+    out << "void lrp_score(const double* x, int* positive_votes, double* value_sum){\n";
+    out << "  int votes = 0;\n";
+    out << "  double sum = 0.0, value;\n";
+    for (size_t t = 0; t < trees.size(); t++){
+      out << "  votes += lrp_tree_" << t << "(x, &value) == 1; sum += value;\n";
+    }
+    out << "  *positive_votes = votes;\n";
+    out << "  *value_sum = sum;\n";
+    out << "}\n\n";
+    out << "}\n";
+  }
+
+  static void generate(const RandomForest& forest, const string& source_path){
+    ofstream out(source_path);
+    if (!out) throw runtime_error("Cannot open source file for writing: " + source_path);
+    generate(forest.get_trees(), out, forest.num_features());
+  }
+
+  /**
+    *@brief Compiles generated source into a shared object with the system compiler.
+    *
+*The compiler is run directly with fork/execvp rather than through a shell, so the paths are passed verbatim whatever
+*characters they hold. @p compiler and @p flags are split on whitespace into separate arguments.
+    *@param compiler Compiler command, $CXX when empty (falling back to c++).
+    *@throws runtime_error if the compiler cannot be started or fails.
+    */
+  static void compile(const string& source_path, const string& library_path, string compiler = "", const string& flags = "-O2"){
+    if (compiler.empty()){
+      const char* cxx = getenv("CXX");
+      compiler = cxx ? cxx : "c++";
+    }
+    vector<string> args;
+    istringstream words(compiler + " " + flags);
+    for (string word; words >> word;) args.push_back(word);
+    if (args.empty()) throw runtime_error("No compiler to compile the forest with.");
+    args.insert(args.end(), {"-shared", "-fPIC", "-o", library_path, source_path});
+    string command;
+    vector<char*> argv;
+    for (string& arg : args){
+      command += (command.empty() ? "" : " ") + arg;
+      argv.push_back(&arg[0]);
+    }
+    argv.push_back(nullptr);
+
+    pid_t pid = fork();
+    if (pid < 0) throw runtime_error("Cannot start the compiler: " + command);
+    if (pid == 0){
+      execvp(argv[0], argv.data());
+      _exit(127);                   //exec failed; the parent reports it as a failed compile
+    }
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0){
+      if (errno != EINTR) throw runtime_error("Lost the compiler process: " + command);
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) throw runtime_error("Compiling the forest failed: " + command);
+  }
+
+private:
+  static void emit_tree(const Node* root, ostream& out){
+    struct Pending {
+      const Node* node;
+      long label;                   //< Label the node's parent jumps to, -1 when the node is reached by falling through.
+    };
+    vector<Pending> stack = {{root, -1}};
+    long labels = 0;
+    while (!stack.empty()){
+      Pending pending = stack.back();
+      stack.pop_back();
+      const Node* node = pending.node;
+      if (pending.label >= 0) out << "n" << pending.label << ":\n";
+      if (node->is_leaf){
+        out << "  *value = " << hexfloat << node->value << defaultfloat << "; return " << node->label << ";\n";
+        continue;
+      }
+      //every path ends in a leaf's return, so the left subtree never falls through into the right one
+      long right = labels++;
+      out << "  if (!(x[" << node->feature_index << "] < " << hexfloat << node->threshold << defaultfloat << ")) goto n" << right << ";\n";
+      stack.push_back({node->right.get(), right});
+      stack.push_back({node->left.get(), -1});
+    }
+  }
+};
+
+/**
+  *@class CompiledForest
+  *@brief Scores rows with a forest compiled by ForestCodeGenerator and loaded with dlopen.
+  *
+*Results are the same as RandomForest::score on the forest the code was generated from, without loading any node from memory.
+*/
+
+class CompiledForest {
+public:
+  CompiledForest() : handle_(nullptr), num_trees_(0), num_features_(0), score_(nullptr) {}
+
+  /**
+    *@brief Loads a shared object built by ForestCodeGenerator::compile.
+    *@throws runtime_error if the library cannot be opened or lacks the generated symbols.
+    */
+  explicit CompiledForest(const string& library_path) : CompiledForest() {
+    load(library_path);
+  }
+
+  ~CompiledForest(){
+    if (handle_) dlclose(handle_);
+  }
+
+  CompiledForest(const CompiledForest&) = delete;
+  CompiledForest& operator=(const CompiledForest&) = delete;
+
+  void load(const string& library_path){
+    void* handle = dlopen(library_path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!handle) throw runtime_error("Cannot load compiled forest: " + string(dlerror()));
+    auto num_trees = reinterpret_cast<int (*)()>(dlsym(handle, "lrp_num_trees"));
+    auto score = reinterpret_cast<ScoreFunction>(dlsym(handle, "lrp_score"));
+    auto num_features = reinterpret_cast<int (*)()>(dlsym(handle, "lrp_num_features"));   //absent from older libraries
+    if (!num_trees || !score){
+      dlclose(handle);
+      throw runtime_error("Not a compiled forest: " + library_path);
+    }
+    if (handle_) dlclose(handle_);
+    handle_ = handle;
+    num_trees_ = num_trees();
+    num_features_ = num_features ? num_features() : 0;
+    score_ = score;
+  }
+
+  /**
+    *@brief Checks that the library was compiled from @p forest, so the two can be used together: same number of trees
+    *and, when the library records it, the same feature count.
+    *@throws runtime_error otherwise.
+    */
+  void check_compiled_from(const RandomForest& forest) const {
+    if (num_trees_ != forest.get_trees().size() || (num_features_ != 0 && num_features_ != forest.num_features())){
+      throw runtime_error("The compiled forest (" + to_string(num_trees_) + " trees, " + to_string(num_features_) + " features) was not compiled from the model ("
+                          + to_string(forest.get_trees().size()) + " trees, " + to_string(forest.num_features()) + " features).");
+    }
+  }
+
+  /**
+    *@brief Same as RandomForest::score. Labels are assumed to be 0/1.
+    *@param feature Vector of features. Extra trailing values (such as the label) are ignored.
+    */
+  RandomForest::ForestScore score(const vector<double>& feature) const {
+    RandomForest::ForestScore result;
+    if (num_trees_ == 0) return result;
+    require_features(feature.size());
+    int positive_votes = 0;
+    double value_sum = 0.0;
+    score_(feature.data(), &positive_votes, &value_sum);
+    result.vote_fraction = positive_votes / (double)num_trees_;
+    result.leaf_frequency = value_sum / num_trees_;
+    return result;
+  }
+
+  /**
+    *@brief Same as RandomForest::score_batch: scores many rows on the shared pool into @p out, resized to rows.size().
+    */
+  void score_batch(const vector<vector<double>>& rows, vector<RandomForest::ForestScore>& out, size_t num_threads = 0) const {
+    LRP_PHASE("compiled.score_batch");
+    LRP_COUNT(RowsScored, rows.size());
+    for (const auto& row : rows) require_features(row.size());   //checked before any row reaches the generated code
+    out.resize(rows.size());
+    ThreadPool::global().parallel_for(rows.size(), [&](size_t i){
+      out[i] = score(rows[i]);
+    }, num_threads);
+  }
+
+  double predict_proba(const vector<double>& feature, RandomForest::ProbabilityMode mode = RandomForest::LeafFrequency) const {
+    return score(feature).probability(mode);
+  }
+
+  /**
+    *@brief Majority vote of the trees, ties go to 0 like RandomForest::predict_early_exit.
+    */
+  int predict(const vector<double>& feature) const {
+    return score(feature).prediction();
+  }
+
+  size_t num_trees() const { return num_trees_; }
+
+  /// @brief Feature count the library was generated for, 0 for libraries that predate recording it.
+  size_t num_features() const { return num_features_; }
+
+  /**
+    *@brief Checks that rows of @p available values cover every feature the generated code reads.
+    *@throws invalid_argument otherwise.
+    */
+  void require_features(size_t available) const {
+    if (available < num_features_) throw invalid_argument("Rows have " + to_string(available) + " values but the compiled forest needs " + to_string(num_features_) + " features.");
+  }
+
+private:
+  typedef void (*ScoreFunction)(const double*, int*, double*);
+
+  void* handle_;                  //< dlopen handle of the loaded library.
+  size_t num_trees_;
+  size_t num_features_;
+  ScoreFunction score_;
+};
+
+#endif  //COMPILEDFOREST_H
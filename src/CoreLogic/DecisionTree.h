@@ -9,15 +9,119 @@
 #define DECISIONTREE_H
 
 #include "Node.h"
+#include "NodeArena.h"
+#include "Histogram.h"
+#include "../Includes/ThreadPool.h"
+#include "../Includes/Instrumentation.h"
+#include "../Includes/Logger.h"
 #include <iostream>
+#include <iomanip>
 #include <vector>
 #include <algorithm>
 #include <limits>
 #include <map>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <sstream>
 #include <unordered_set>
 
 using namespace std;
 
+/**
+  *@brief Number of candidate features drawn at random for every split (mtry).
+  */
+struct MaxFeatures {
+  enum Kind { All, Sqrt, Log2, Fraction, Count };
+  Kind kind = All;
+  double value = 0.0;                       //< Share of the features for Fraction, number of features for Count.
+
+  /**
+    *@brief Parses "all", "sqrt", "log2", a fraction such as "0.3" or a count such as "5".
+    *@throws invalid_argument if the text is none of these.
+    */
+  static MaxFeatures parse(const string& text){
+    MaxFeatures result;
+    if (text == "all") return result;
+    if (text == "sqrt") { result.kind = Sqrt; return result; }
+    if (text == "log2") { result.kind = Log2; return result; }
+    size_t consumed = 0;
+    double value = 0.0;
+    try {
+      value = stod(text, &consumed);
+    } catch (...) {
+      consumed = 0;
+    }
+    if (consumed != text.size() || value <= 0) throw invalid_argument("Invalid max_features: " + text);
+    bool is_integer = text.find('.') == string::npos;
+    result.kind = is_integer ? Count : Fraction;
+    result.value = value;
+    if (!is_integer && value > 1.0) throw invalid_argument("max_features fraction must be in (0, 1]: " + text);
+    return result;
+  }
+
+  /// @brief The text parse reads back: "all", "sqrt", "log2", a fraction or a count.
+  string describe() const {
+    switch (kind){
+      case All: return "all";
+      case Sqrt: return "sqrt";
+      case Log2: return "log2";
+      case Count: return std::to_string(static_cast<long long>(value));
+      case Fraction: break;
+    }
+    ostringstream text;
+    text << value;
+    string fraction = text.str();
+    return fraction.find('.') == string::npos ? fraction + ".0" : fraction;
+  }
+
+  /// @brief Number of features to draw out of @p num_features, between 1 and num_features.
+  size_t resolve(size_t num_features) const {
+    double count = num_features;
+    switch (kind){
+      case All: break;
+      case Sqrt: count = floor(sqrt((double)num_features)); break;
+      case Log2: count = floor(log2((double)num_features)); break;
+      case Fraction: count = floor(value * num_features); break;
+      case Count: count = value; break;
+    }
+    if (count < 1) count = 1;
+    if (count > num_features) count = num_features;
+    return static_cast<size_t>(count);
+  }
+};
+
+/**
+  *@brief How a node picks the threshold of a candidate feature.
+  */
+enum SplitMode {
+  BestSplit,                                //< Sort the node's values and scan every threshold (find_best_split).
+  RandomSplit                               //< Draw one threshold uniformly between the node's min and max (Extremely Randomized Trees).
+};
+
+/**
+  *@brief Stopping criteria applied while a DecisionTree is grown (pre-pruning), plus per-split feature subsampling.
+  *
+*The defaults reproduce a fully grown tree over every feature, which only stops at pure nodes.
+*/
+struct TreeOptions {
+  int max_depth = -1;                       //< Maximum depth of the tree, -1 for unlimited.
+  size_t min_samples_split = 2;             //< Minimum number of rows a node needs before it may be split.
+  size_t min_samples_leaf = 1;              //< Minimum number of rows each child of a split must receive.
+  int max_leaf_nodes = -1;                  //< Maximum number of leaves in the tree, -1 for unlimited.
+  double min_impurity_decrease = 0.0;       //< Minimum weighted gini decrease (relative to the whole training set) a split must achieve.
+  size_t num_threads = 0;                   //< Threads used while building one tree, 0 for the whole shared pool, 1 for serial.
+  size_t parallel_split_min_samples = 2048; //< Nodes with at least this many rows search their features in parallel, smaller nodes stay serial.
+  MaxFeatures max_features;                 //< Features drawn per node from the tree's candidate features.
+  SplitMode split_mode = BestSplit;         //< BestSplit scans every value, RandomSplit draws one threshold per feature (ExtraTrees).
+  unsigned int seed = 5489u;                //< Seed of the tree's own RNG, which draws the per-node features.
+  bool huge_pages = false;                  //< Back the tree's node arena with transparent huge pages once chunks reach 2 MiB.
+  int max_bins = 0;                         //< 0 for exact sorted BestSplit search, 2 to 256 to search label histograms of the data quantized once into that many bins per feature.
+};
+
 /**
   *@class DecisionTree
   *@brief Manage the creation and operation of a decision tree.
@@ -28,30 +132,76 @@ using namespace std;
 
 class DecisionTree {
 public:
-  DecisionTree() : root (new Node()) {}                                    //< Constructor initializes the tree with a root node.
+  DecisionTree(const TreeOptions& options = TreeOptions()) : root (new Node()), options_(options) {}      //< Constructor initializes the tree with a root node.
+  explicit DecisionTree(NodePtr root_node) : root (move(root_node)) {}                                  //< Adopts a tree grown elsewhere (boosting).
+  ~DecisionTree(){ root.reset(); }                                                                      //< Drops the nodes before the arena that holds them.
+  DecisionTree(DecisionTree&&) = default;
+  DecisionTree& operator=(DecisionTree&&) = default;                                                   //< Moves root before arena_, so the old nodes go first.
   
   void train(vector<vector<double>>& data_vec, const unordered_set<int>& sampled_features = {}){                    //< Trains the decision tree using the provided 
-    cout << "Training Decision Tree..." <<endl;
+    vector<size_t> rows(data_vec.size());
+    iota(rows.begin(), rows.end(), 0);
+    train_rows(data_vec, rows, sampled_features);
+  }
+
+  /**
+    *@brief Trains on the rows of @p data_vec listed in @p rows, which may repeat (a bootstrap sample).
+    *
+*Only the listed rows are copied, once, into the tree's own feature matrix, so a sample of a shared dataset never has to be materialized.
+*@param binned data_vec quantized by BinnedMatrix, row for row, searched by BestSplit instead of sorting. Shared read-only, so many trees
+*can bin the data once. Null bins the data here if max_bins is set.
+*/
+  void train_rows(const vector<vector<double>>& data_vec, const vector<size_t>& rows, const unordered_set<int>& sampled_features = {}, const BinnedMatrix* binned = nullptr){
+    //with max_bins set and no shared binning, the tree quantizes the data itself, once
+    unique_ptr<BinnedMatrix> own_binned;
+    if (!binned && options_.max_bins > 0 && options_.split_mode == BestSplit && !data_vec.empty()){
+      own_binned.reset(new BinnedMatrix(data_vec, data_vec[0].size() - 1, options_.max_bins, options_.num_threads));
+      binned = own_binned.get();
+    }
+    LRP_LOG_DEBUG("tree.train", "Training decision tree on " << rows.size() << " rows");
+    LRP_PHASE("tree.train");
     unordered_set<int> modifiable_sample_features = sampled_features;
 
     if (modifiable_sample_features.empty()){
-      for(size_t i = 0; i < data_vec[0].size(); i++){
+      const size_t num_features = data_vec[0].size() - 1;          //the last column is the label, never a candidate
+      for(size_t i = 0; i < num_features; i++){
         modifiable_sample_features.insert(i);
       }
     }
     //Separate features and labels
-    vector<vector<double>> features(data_vec.size());
-    vector<int> labels (data_vec.size());
+    vector<vector<double>> features(rows.size());
+    vector<int> labels (rows.size());
 
-    for (size_t i = 0; i < data_vec.size(); i++){
+    for (size_t i = 0; i < rows.size(); i++){
+      const vector<double>& row = data_vec[rows[i]];
       //Copy all elements expect the last as features
-      features[i] = vector<double>(data_vec[i].begin(), data_vec[i].end() - 1);
+      features[i] = vector<double>(row.begin(), row.end() - 1);
       //Last Element is the label
-      labels[i] = static_cast<int>(data_vec[i].back());
+      labels[i] = static_cast<int>(row.back());
     }
-     build_tree(root.get(), features, labels, 0, data_vec.size(), modifiable_sample_features);
+    root.reset();
+    arena_.reset(new NodeArena(options_.huge_pages));             //frees the previous tree in one shot
+    root.reset(arena_->create());
+    total_samples_ = rows.size();
+    leaf_count_ = 1;
+    impurity_importance_.assign(data_vec[0].size() - 1, 0.0);
+    build_tree(features, labels, modifiable_sample_features, options_.split_mode == BestSplit ? binned : nullptr, rows);
+    LRP_COUNT(TreesTrained, 1);
+    LRP_COUNT(BytesAllocated, arena_->bytes_reserved());
   }
 
+  /// @brief Returns the stopping criteria used when growing this tree.
+  const TreeOptions& get_options() const { return options_; }
+
+  /// @brief Weighted gini decrease of the splits on every feature, accumulated by train; empty for loaded or adopted trees.
+  const vector<double>& get_impurity_importance() const { return impurity_importance_; }
+
+  /// @brief Bytes of node memory held by the tree's arena, 0 for adopted trees.
+  size_t arena_bytes() const { return arena_ ? arena_->bytes_reserved() : 0; }
+
+  /// @brief Sets the seed of the per-tree RNG used by the next call to train.
+  void set_seed(unsigned int seed){ options_.seed = seed; }
+
   int predict(const vector<double>& feature, bool verbose = false){                              //< predicts the class label for the given features.
     Node* node = root.get();
     if (verbose) cout << "Starting at root " <<endl;
@@ -69,49 +219,110 @@ public:
     return node->label; 
   }
 
+  /// @brief Returns the leaf reached by the given features.
+  const Node* find_leaf(const vector<double>& feature) const {
+    const Node* node = root.get();
+    while (!node->is_leaf){
+      node = (feature[node->feature_index] < node->threshold) ? node->left.get() : node->right.get();
+    }
+    return node;
+  }
+
+  /// @brief Predicts the real-valued output (Node::value) of the leaf reached by the given features.
+  double predict_value(const vector<double>& feature) const { return find_leaf(feature)->value; }
+
+  /// @brief Returns the root node, for code that walks the trained tree.
+  const Node* get_root() const { return root.get(); }
+
+  /// @brief Largest feature index any split tests, -1 for a single leaf. Rows passed to predict must hold more values than this.
+  int max_split_feature() const {
+    int largest = -1;
+    if (!root) return largest;
+    vector<const Node*> stack = {root.get()};
+    while (!stack.empty()){
+      const Node* node = stack.back();
+      stack.pop_back();
+      if (node->is_leaf) continue;
+      largest = max(largest, node->feature_index);
+      stack.push_back(node->left.get());
+      stack.push_back(node->right.get());
+    }
+    return largest;
+  }
+
+  /**
+    *@brief Writes the tree in the model file format: one line per node in preorder.
+    *
+    *A split node is "S <feature_index> <threshold>", a leaf is "L <label> <value>", followed by "end".
+    *Doubles are written with 17 significant digits so they load back bit-identical.
+    */
+  void save(ostream& out) const {
+    out << setprecision(17);
+    vector<const Node*> stack = {root.get()};
+    while (!stack.empty()){
+      const Node* node = stack.back();
+      stack.pop_back();
+      if (node->is_leaf){
+        out << "L " << node->label << " " << node->value << "\n";
+      } else {
+        out << "S " << node->feature_index << " " << node->threshold << "\n";
+        stack.push_back(node->right.get());
+        stack.push_back(node->left.get());
+      }
+    }
+    out << "end\n";
+  }
+
+  /**
+    *@brief Reads a tree written by save, replacing the current one.
+    *@throws runtime_error if the stream does not hold a valid tree.
+    */
+  void load(istream& in){
+    unique_ptr<NodeArena> arena(new NodeArena());
+    NodePtr loaded;
+    vector<NodePtr*> stack = {&loaded};
+    string line;
+    while (!stack.empty()){
+      if (!getline(in, line)) throw runtime_error("Unexpected end of model file.");
+      istringstream fields(line);
+      char kind;
+      fields >> kind;
+      NodePtr* slot = stack.back();
+      stack.pop_back();
+      slot->reset(arena->create());
+      Node* node = slot->get();
+      if (kind == 'L'){
+        node->is_leaf = true;
+        fields >> node->label >> node->value;
+      } else if (kind == 'S'){
+        fields >> node->feature_index >> node->threshold;
+        if (node->feature_index < 0) throw runtime_error("Invalid node in model file: " + line);
+        stack.push_back(&node->right);
+        stack.push_back(&node->left);
+      } else {
+        throw runtime_error("Invalid node in model file: " + line);
+      }
+      if (fields.fail()) throw runtime_error("Invalid node in model file: " + line);
+    }
+    if (!getline(in, line) || line != "end") throw runtime_error("Missing end of tree in model file.");
+    root = move(loaded);
+    arena_ = move(arena);
+    impurity_importance_.clear();
+  }
+
   struct SplitResult {
     double gini;                  //< Gini index of the split.
     double threshold;             //< Threshold value of the split.
     size_t feature_index;
   };
 
-SplitResult find_best_split(const vector<vector<double>>& features, const vector<int>& labels, size_t start, size_t end, size_t feature_index) {
+SplitResult find_best_split(const vector<vector<double>>& features, const vector<int>& labels, size_t start, size_t end, size_t feature_index, size_t min_samples_leaf = 1) {
     // Create a vector of pairs of features and labels to sort by features
     vector<pair<double, int>> feature_label_pairs;
     for (size_t i = start; i < end; ++i) {
         feature_label_pairs.emplace_back(features[i][feature_index], labels[i]);
     }
-
-    // Sort pairs by the feature values
-    sort(feature_label_pairs.begin(), feature_label_pairs.end());
-
-    map<double, int> left_counts, right_counts;
-    for (const auto& fl : feature_label_pairs) {
-        right_counts[fl.second]++;
-    }
-
-    int left_size = 0, right_size = feature_label_pairs.size();
-    double best_gini = numeric_limits<double>::max();
-    double best_threshold = 0;
-    size_t best_feature_index = feature_index;
-
-    for (size_t i = 0; i < feature_label_pairs.size() - 1; ++i) {
-        int label = feature_label_pairs[i].second;
-        left_counts[label]++;
-        right_counts[label]--;
-        left_size++;
-        right_size--;
-
-        if (feature_label_pairs[i].first != feature_label_pairs[i + 1].first) {
-            double threshold = feature_label_pairs[i + 1].first;  // Use the next feature value as the threshold
-            double gini = calculate_gini_index(left_counts, right_counts, left_size, right_size);
-            if (gini < best_gini) {
-                best_gini = gini;
-                best_threshold = threshold;
-            }
-        }
-    }
-    return {best_gini, best_threshold, best_feature_index};
+    return best_split_of_pairs(feature_label_pairs, feature_index, min_samples_leaf);
 }
 
   double calculate_gini_index(const map<double, int>& left_counts,const map<double, int>& right_counts, int left_size, int right_size){     //< Calculates the Gini index for a given split.
@@ -158,27 +369,179 @@ size_t partition_data(vector<vector<double>>& data_vec, size_t start, size_t end
 }
 
 private:
-  unique_ptr<Node> root;                                          //< Unique pointer to the root node of decision tree
-void build_tree(Node* node, vector<vector<double>>& features, const vector<int>& labels, size_t start, size_t end, const unordered_set<int>& sampled_features){      //< Recursive function to build the tree.
-    if(start >= end){ 
-      cout << "No data in range. Turning into a leaf." << endl;
-      return;
+  NodePtr root;                                                   //< Unique pointer to the root node of decision tree
+  unique_ptr<NodeArena> arena_;                                   //< Storage of the nodes grown by train or read by load, released with the tree
+  TreeOptions options_;                                           //< Pre-pruning limits used by build_tree
+  size_t total_samples_ = 0;                                      //< Number of rows the tree is trained on
+  int leaf_count_ = 1;                                            //< Number of leaves grown so far, checked against max_leaf_nodes
+  vector<double> impurity_importance_;                            //< Weighted gini decrease per feature of the splits made by train
+  const BinnedMatrix* binned_ = nullptr;                          //< Quantized data searched by histogram splits while training, null for exact splits
+  const vector<size_t>* data_rows_ = nullptr;                     //< Row of the binned data behind every training sample
+  vector<int> class_ids_;                                         //< Index of every sample's label among the sorted distinct labels, for histogram splits
+  size_t num_classes_ = 0;
+
+  struct OpenNode {               //< A node waiting to be split, covering rows[start, end).
+    Node* node;
+    size_t start;
+    size_t end;
+    int depth;
+    vector<int> features;         //< Candidate features drawn for this node.
+    unsigned int seed;            //< Seed for the node's random thresholds, drawn sequentially like the features.
+  };
+
+  struct NodeDecision {           //< Outcome of evaluating an open node.
+    bool split = false;
+    int feature_index = -1;
+    double threshold = 0.0;
+    double gini = 0.0;            //< Weighted gini of the split, or the node's own gini for a leaf.
+    int label = -1;               //< Majority label, used if the node ends up a leaf.
+    double positive_fraction = 0.0; //< Share of the node's rows labelled 1, stored in Node::value if it ends up a leaf.
+    double impurity_decrease = 0.0; //< Gini decrease of the split weighted by the node's share of the training rows.
+  };
+
+  /**
+    *@brief Level-wise tree builder.
+    *
+    *Keeps a queue of open nodes instead of recursing, so skewed data cannot exhaust the stack.
+    *Every node of a level is evaluated in one parallel sweep over the shared pool, then the chosen splits are
+    *applied in breadth-first order and the rows of each split node are partitioned, also in parallel.
+    *Rows are moved through an index array, so the feature matrix itself is never reordered.
+    */
+  void build_tree(const vector<vector<double>>& features, const vector<int>& labels, const unordered_set<int>& sampled_features, const BinnedMatrix* binned, const vector<size_t>& data_rows){
+    binned_ = binned;
+    data_rows_ = &data_rows;
+    if (binned_){
+      vector<int> classes(labels);
+      sort(classes.begin(), classes.end());
+      classes.erase(unique(classes.begin(), classes.end()), classes.end());
+      num_classes_ = classes.size();
+      class_ids_.resize(labels.size());
+      for (size_t i = 0; i < labels.size(); i++) class_ids_[i] = lower_bound(classes.begin(), classes.end(), labels[i]) - classes.begin();
     }
+    vector<size_t> rows(features.size());
+    iota(rows.begin(), rows.end(), 0);
+    vector<int> feature_list(sampled_features.begin(), sampled_features.end());
+    sort(feature_list.begin(), feature_list.end());
+    size_t features_per_node = options_.max_features.resolve(feature_list.size());
+    mt19937 rng(options_.seed);
+    ThreadPool& pool = ThreadPool::global();
+
+    vector<OpenNode> level = {{root.get(), 0, rows.size(), 0, draw_features(feature_list, features_per_node, rng), static_cast<unsigned int>(rng())}};
+    while (!level.empty()){
+      vector<NodeDecision> decisions(level.size());
+      {
+        LRP_PHASE("tree.train/evaluate_level");
+        pool.parallel_for(level.size(), [&](size_t i){
+          decisions[i] = evaluate_node(level[i], features, labels, rows);
+        }, options_.num_threads);
+      }
+      LRP_COUNT(NodesBuilt, level.size());
+
+      //apply in breadth-first order so that max_leaf_nodes keeps the shallowest splits
+      vector<size_t> split_nodes;
+      for (size_t i = 0; i < level.size(); i++){
+        Node* node = level[i].node;
+        const NodeDecision& decision = decisions[i];
+        node -> gini_index = decision.gini;
+        if (!decision.split || (options_.max_leaf_nodes > 0 && leaf_count_ >= options_.max_leaf_nodes)){
+          node -> is_leaf = true;
+          node -> label = decision.label;
+          node -> value = decision.positive_fraction;
+          continue;
+        }
+        node -> feature_index = decision.feature_index;
+        node -> threshold = decision.threshold;
+        impurity_importance_[decision.feature_index] += decision.impurity_decrease;
+        node->left.reset(arena_->create());
+        node->right.reset(arena_->create());
+        leaf_count_++;
+        split_nodes.push_back(i);
+      }
+
+      vector<size_t> split_index(split_nodes.size());
+      {
+        LRP_PHASE("tree.train/partition_level");
+        pool.parallel_for(split_nodes.size(), [&](size_t s){
+          const OpenNode& open = level[split_nodes[s]];
+          split_index[s] = partition_rows(features, rows, open.start, open.end, open.node->feature_index, open.node->threshold);
+          LRP_COUNT(RowsPartitioned, open.end - open.start);
+        }, options_.num_threads);
+      }
+
+      vector<OpenNode> next_level;
+      for (size_t s = 0; s < split_nodes.size(); s++){
+        const OpenNode& open = level[split_nodes[s]];
+        next_level.push_back({open.node->left.get(), open.start, split_index[s], open.depth + 1, draw_features(feature_list, features_per_node, rng), static_cast<unsigned int>(rng())});
+        next_level.push_back({open.node->right.get(), split_index[s], open.end, open.depth + 1, draw_features(feature_list, features_per_node, rng), static_cast<unsigned int>(rng())});
+      }
+      level.swap(next_level);
+    }
+    binned_ = nullptr;
+    data_rows_ = nullptr;
+    class_ids_.clear();
+    class_ids_.shrink_to_fit();
+  }
+
+  vector<int> draw_features(const vector<int>& feature_list, size_t count, mt19937& rng){      //< Partial Fisher-Yates draw of count features, drawn sequentially so the tree is reproducible.
+    vector<int> drawn = feature_list;
+    if (count >= drawn.size()) return drawn;
+    for (size_t i = 0; i < count; i++){
+      uniform_int_distribution<size_t> dist(i, drawn.size() - 1);
+      swap(drawn[i], drawn[dist(rng)]);
+    }
+    drawn.resize(count);
+    return drawn;
+  }
+
+  NodeDecision evaluate_node(const OpenNode& open, const vector<vector<double>>& features, const vector<int>& labels, const vector<size_t>& rows){
+    const vector<int>& feature_list = open.features;
+    NodeDecision decision;
+    size_t num_samples = open.end - open.start;
+    map<int, int> label_counts;
+    for (size_t i = open.start; i < open.end; ++i){
+      label_counts[labels[rows[i]]]++;
+    }
+    double node_gini = 1.0;
+    int max_count = 0;
+    for (const auto& pair : label_counts){
+      double p = pair.second / (double)num_samples;
+      node_gini -= p * p;
+      if (pair.second > max_count){
+        max_count = pair.second;
+        decision.label = pair.first;
+      }
+    }
+    decision.gini = node_gini;
+    auto positive = label_counts.find(1);
+    decision.positive_fraction = positive == label_counts.end() ? 0.0 : positive->second / (double)num_samples;
 
     //determine if this node should be a leaf
-    if (should_be_leaf(labels, start, end)){
-      node -> is_leaf = true;
-      node -> label = determine_label(labels, start, end);
-      return;
+    if (label_counts.size() <= 1 || reached_limits(num_samples, open.depth)) return decision;
+
+    //Find the best split; large nodes fan their features out over the pool, the reduction keeps feature order
+    vector<SplitResult> results(feature_list.size());
+    LRP_COUNT(SplitsEvaluated, feature_list.size());
+    auto search_feature = [&](size_t f){
+      if (options_.split_mode == RandomSplit){
+        results[f] = random_split_rows(features, labels, rows, open.start, open.end, feature_list[f], options_.min_samples_leaf, open.seed);
+      } else if (binned_){
+        results[f] = histogram_split_rows(rows, open.start, open.end, feature_list[f], options_.min_samples_leaf);
+      } else {
+        results[f] = find_best_split_rows(features, labels, rows, open.start, open.end, feature_list[f], options_.min_samples_leaf);
+      }
+    };
+    if (num_samples >= options_.parallel_split_min_samples){
+      ThreadPool::global().parallel_for(feature_list.size(), search_feature, options_.num_threads);
+    } else {
+      for (size_t f = 0; f < feature_list.size(); f++) search_feature(f);
     }
-    
-    //Find the best split
+
     int best_feature = -1;
-    double best_threshold;
+    double best_threshold = 0.0;
     double best_gini = numeric_limits<double>::max();
-
-    for (int feature_index : sampled_features){
-      auto result = find_best_split(features, labels, start, end, feature_index);
+    for (size_t f = 0; f < feature_list.size(); f++){
+      int feature_index = feature_list[f];
+      const SplitResult& result = results[f];
       if (result.gini < best_gini){
         best_gini = result.gini;
         best_feature = feature_index;
@@ -186,45 +549,168 @@ void build_tree(Node* node, vector<vector<double>>& features, const vector<int>&
       }
     }
 
-    //set the node's properties
-    node -> feature_index = best_feature;
-    node -> threshold = best_threshold;
-    node -> gini_index = best_gini;                                                                                                                                                                                                                                                                                                          
+    //no valid split (all sampled features constant, or min_samples_leaf unreachable), or the split is not worth it
+    double impurity_decrease = num_samples / (double)total_samples_ * (node_gini - best_gini);
+    if (best_feature < 0 || impurity_decrease < options_.min_impurity_decrease) return decision;
+
+    decision.split = true;
+    decision.feature_index = best_feature;
+    decision.threshold = best_threshold;
+    decision.gini = best_gini;
+    decision.impurity_decrease = impurity_decrease;
+    return decision;
+  }
+
+  bool reached_limits(size_t num_samples, int depth){                                 //< Pre-pruning checks that do not need a split search.
+    if (options_.max_depth >= 0 && depth >= options_.max_depth) return true;
+    if (num_samples < options_.min_samples_split) return true;
+    if (num_samples < 2 * options_.min_samples_leaf) return true;
+    return false;
+  }
 
-    //recursively build the left and right subtrees
-    node->left.reset(new Node());
-    node->right.reset(new Node());
-    size_t split_index = partition_data(features, start, end, best_feature, best_threshold);
-    build_tree(node->left.get(), features, labels, start, split_index, sampled_features);
-    build_tree(node->right.get(), features, labels, split_index, end, sampled_features);
+  SplitResult find_best_split_rows(const vector<vector<double>>& features, const vector<int>& labels, const vector<size_t>& rows, size_t start, size_t end, size_t feature_index, size_t min_samples_leaf){   //< find_best_split over rows[start, end).
+    vector<pair<double, int>> feature_label_pairs;
+    feature_label_pairs.reserve(end - start);
+    for (size_t i = start; i < end; ++i){
+      feature_label_pairs.emplace_back(features[rows[i]][feature_index], labels[rows[i]]);
+    }
+    return best_split_of_pairs(feature_label_pairs, feature_index, min_samples_leaf);
   }
 
-   bool should_be_leaf(const vector<int>& labels, size_t start, size_t end){            //< Determine if the current node should be a leaf.
-    //Example stopping condition: if all data points have the same label
-    int first_label = labels[start];
-    for (size_t i = start + 1; i < end; ++i){
-      if (labels[i] != first_label){
-        return false;
+  /**
+    *@brief BestSplit over the bins of a feature: counts the node's labels per bin in one pass and scans the bin boundaries, without sorting.
+    *
+*The threshold is the cut value above the chosen bin, so "value < threshold" sends exactly the rows of the bins up to it left.
+*@return A gini of numeric_limits<double>::max() if the node's rows share one bin or min_samples_leaf cannot be met.
+*/
+  SplitResult histogram_split_rows(const vector<size_t>& rows, size_t start, size_t end, size_t feature_index, size_t min_samples_leaf){
+    const vector<uint8_t>& column = binned_->column(feature_index);
+    const vector<size_t>& data_rows = *data_rows_;
+    size_t num_bins = binned_->num_bins(feature_index);
+    vector<int> histogram(num_bins * num_classes_, 0);
+    for (size_t i = start; i < end; ++i){
+      histogram[column[data_rows[rows[i]]] * num_classes_ + class_ids_[rows[i]]]++;
+    }
+    vector<int> left_counts(num_classes_, 0), right_counts(num_classes_, 0);
+    for (size_t b = 0; b < num_bins; b++){
+      for (size_t c = 0; c < num_classes_; c++) right_counts[c] += histogram[b * num_classes_ + c];
+    }
+
+    SplitResult result = {numeric_limits<double>::max(), 0.0, feature_index};
+    int left_size = 0, right_size = end - start;
+    for (size_t b = 0; b + 1 < num_bins; b++){
+      int moved = 0;
+      for (size_t c = 0; c < num_classes_; c++){
+        int count = histogram[b * num_classes_ + c];
+        left_counts[c] += count;
+        right_counts[c] -= count;
+        moved += count;
+      }
+      if (moved == 0) continue;                 //an empty bin repeats the previous split
+      left_size += moved;
+      right_size -= moved;
+      if (right_size == 0) break;
+      if (static_cast<size_t>(left_size) < min_samples_leaf || static_cast<size_t>(right_size) < min_samples_leaf) continue;
+      double left_gini = 1.0, right_gini = 1.0;
+      for (size_t c = 0; c < num_classes_; c++){
+        double p = left_counts[c] / (double)left_size;
+        double q = right_counts[c] / (double)right_size;
+        left_gini -= p * p;
+        right_gini -= q * q;
+      }
+      double gini = (left_gini * left_size + right_gini * right_size) / (left_size + right_size);
+      if (gini < result.gini){
+        result.gini = gini;
+        result.threshold = binned_->cuts(feature_index)[b];
       }
     }
-  return true;
+    return result;
   }
 
-  int determine_label(const vector<int>& labels, size_t start, size_t end){         //< Determine the label of the leaf node based on majority voting.
-    //Majority voting for label
-    map<int, int> label_counts;
+  /**
+    *@brief ExtraTrees split: one threshold drawn uniformly in (min, max] of the node's values, scored in a single O(n) pass without sorting.
+    *@return A gini of numeric_limits<double>::max() if the feature is constant or min_samples_leaf cannot be met.
+    */
+  SplitResult random_split_rows(const vector<vector<double>>& features, const vector<int>& labels, const vector<size_t>& rows, size_t start, size_t end, size_t feature_index, size_t min_samples_leaf, unsigned int node_seed){
+    double lo = numeric_limits<double>::max(), hi = numeric_limits<double>::lowest();
     for (size_t i = start; i < end; ++i){
-      label_counts[labels[i]]++;
+      double value = features[rows[i]][feature_index];
+      if (value < lo) lo = value;
+      if (value > hi) hi = value;
     }
-    int majority_label = -1;
-    int max_count = 0;
-    for(auto& pair : label_counts){
-      if (pair.second > max_count){
-        max_count = pair.second;
-        majority_label = pair.first;
+    SplitResult result = {numeric_limits<double>::max(), 0.0, feature_index};
+    if (!(lo < hi)) return result;
+
+    //splitmix64 of (node seed, feature): depends only on the node and the feature, not on which thread evaluates it
+    uint64_t z = (static_cast<uint64_t>(node_seed) << 32 | feature_index) + 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    double u = ((z >> 11) + 1) * 0x1.0p-53;                                  //in (0, 1], so the threshold is above lo
+    double threshold = lo + u * (hi - lo);
+    if (threshold <= lo) threshold = hi;
+
+    map<double, int> left_counts, right_counts;
+    int left_size = 0, right_size = 0;
+    for (size_t i = start; i < end; ++i){
+      if (features[rows[i]][feature_index] < threshold){
+        left_counts[labels[rows[i]]]++;
+        left_size++;
+      } else {
+        right_counts[labels[rows[i]]]++;
+        right_size++;
+      }
+    }
+    if (static_cast<size_t>(left_size) < min_samples_leaf || static_cast<size_t>(right_size) < min_samples_leaf) return result;
+    result.gini = calculate_gini_index(left_counts, right_counts, left_size, right_size);
+    result.threshold = threshold;
+    return result;
+  }
+
+SplitResult best_split_of_pairs(vector<pair<double, int>>& feature_label_pairs, size_t feature_index, size_t min_samples_leaf) {       //< Sorts (value, label) pairs and scans every threshold.
+    // Sort pairs by the feature values
+    sort(feature_label_pairs.begin(), feature_label_pairs.end());
+
+    map<double, int> left_counts, right_counts;
+    for (const auto& fl : feature_label_pairs) {
+        right_counts[fl.second]++;
+    }
+
+    int left_size = 0, right_size = feature_label_pairs.size();
+    double best_gini = numeric_limits<double>::max();
+    double best_threshold = 0;
+    size_t best_feature_index = feature_index;
+
+    for (size_t i = 0; i < feature_label_pairs.size() - 1; ++i) {
+        int label = feature_label_pairs[i].second;
+        left_counts[label]++;
+        right_counts[label]--;
+        left_size++;
+        right_size--;
+
+        if (feature_label_pairs[i].first != feature_label_pairs[i + 1].first
+            && static_cast<size_t>(left_size) >= min_samples_leaf && static_cast<size_t>(right_size) >= min_samples_leaf) {
+            double threshold = feature_label_pairs[i + 1].first;  // Use the next feature value as the threshold
+            double gini = calculate_gini_index(left_counts, right_counts, left_size, right_size);
+            if (gini < best_gini) {
+                best_gini = gini;
+                best_threshold = threshold;
+            }
+        }
+    }
+    return {best_gini, best_threshold, best_feature_index};
+}
+
+
+  size_t partition_rows(const vector<vector<double>>& features, vector<size_t>& rows, size_t start, size_t end, int feature_index, double threshold){   //< Partitions rows[start, end) so rows going left come first.
+    size_t mid = start;
+    for (size_t i = start; i < end; ++i){
+      if (features[rows[i]][feature_index] < threshold){
+        swap(rows[mid], rows[i]);
+        mid++;
       }
     }
-    return majority_label;
+    return mid;
   }
 
 };
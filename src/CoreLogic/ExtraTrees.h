@@ -0,0 +1,36 @@
+#ifndef EXTRATREES_H
+#define EXTRATREES_H
+
+#include "RandomForest.h"
+
+using namespace std;
+
+/**
+  *@file ExtraTrees.h
+  *@brief Header file for the ExtraTrees class.
+  *Contian both declaration and implementation.
+  *
+  *Extremely Randomized Trees: a RandomForest whose trees draw one random threshold per candidate feature
+  *instead of sorting and scanning every value, and which train on the whole training split instead of bootstrap samples.
+  *Nodes, voting, evaluation and cross validation are shared with RandomForest.
+  */
+
+class ExtraTrees : public RandomForest{
+public:
+  /**
+    *@brief Constructor that initializes the ensemble with a specified number of trees.
+    *@param num_trees Number of trees to include in the ensemble.
+    *@param tree_options Options applied to every tree; the split mode is forced to RandomSplit.
+    */
+  ExtraTrees(int num_trees, const TreeOptions& tree_options = default_tree_options()): RandomForest(num_trees, with_random_splits(tree_options)){
+    bootstrap_ = false;
+  }
+
+private:
+  static TreeOptions with_random_splits(TreeOptions options){
+    options.split_mode = RandomSplit;
+    return options;
+  }
+};
+
+#endif  //EXTRATREES_H
@@ -0,0 +1,103 @@
+//FeatureImportance.h
+/**
+  *@file FeatureImportance.h
+  *@brief Header file for permutation feature importance of a RandomForest
+  *Contain both declaraction and implementation
+*/
+
+#ifndef FEATUREIMPORTANCE_H
+#define FEATUREIMPORTANCE_H
+
+#include "RandomForest.h"
+#include "../Includes/ThreadPool.h"
+#include "../Includes/Instrumentation.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+
+using namespace std;
+
+/**
+  *@brief How much worse the forest scores a held-out set once a feature's values are shuffled across rows.
+  */
+struct PermutationImportance {
+  double baseline_accuracy = 0.0;           //< Accuracy on the unshuffled rows.
+  double baseline_brier = 0.0;              //< Mean squared error of the leaf-frequency probability on the unshuffled rows.
+  vector<double> accuracy_decrease;         //< Per feature, mean drop in accuracy over the repeats.
+  vector<double> accuracy_stddev;           //< Per feature, standard deviation of the drop over the repeats.
+  vector<double> brier_increase;            //< Per feature, mean rise in Brier score; moves even when few predictions flip.
+};
+
+/**
+  *@brief Permutation importance of every feature on @p rows, which should be held out from training.
+  *
+*Every (feature, repeat) pair shuffles one column into its own vector and rescores every row with
+*RandomForest::score_batch_with_column, which reads that column in place of the row's value, so the rows are never copied
+*or modified. The pairs run in parallel on the shared pool, each scoring serially. The shuffles depend only on @p seed,
+*not on the thread count. Select the SIMD backend first: the other backends copy every row they rescore.
+*@param rows Rows with the label last.
+*@param repeats Shuffles per feature, averaged.
+*@param num_threads Threads working on features, 0 for the whole shared pool.
+*/
+inline PermutationImportance permutation_importance(const RandomForest& forest, const vector<vector<double>>& rows, int repeats = 5, unsigned int seed = 5489u, size_t num_threads = 0){
+  LRP_PHASE("importance.permutation");
+  if (rows.empty() || repeats < 1) throw invalid_argument("Permutation importance needs rows and at least one repeat.");
+  const size_t num_rows = rows.size();
+  const size_t num_features = rows[0].size() - 1;
+
+  //accuracy and Brier score of one scoring pass
+  auto measure = [&](const vector<RandomForest::ForestScore>& scores, double& accuracy, double& brier){
+    size_t correct = 0;
+    double squared_error = 0.0;
+    for (size_t i = 0; i < num_rows; i++){
+      double label = rows[i].back();
+      if (scores[i].prediction() == static_cast<int>(label)) correct++;
+      double error = scores[i].leaf_frequency - label;
+      squared_error += error * error;
+    }
+    accuracy = correct / (double)num_rows;
+    brier = squared_error / num_rows;
+  };
+
+  PermutationImportance result;
+  vector<RandomForest::ForestScore> scores;
+  forest.score_batch(rows, scores, num_threads);
+  measure(scores, result.baseline_accuracy, result.baseline_brier);
+
+  //one seed per (feature, repeat), drawn up front so the shuffles do not depend on scheduling
+  mt19937 rng(seed);
+  vector<unsigned int> seeds(num_features * repeats);
+  for (unsigned int& task_seed : seeds) task_seed = rng();
+  vector<double> accuracy(seeds.size()), brier(seeds.size());
+  ThreadPool::global().parallel_for(seeds.size(), [&](size_t task){
+    size_t feature = task / repeats;
+    vector<double> column(num_rows);
+    for (size_t i = 0; i < num_rows; i++) column[i] = rows[i][feature];
+    mt19937 task_rng(seeds[task]);
+    shuffle(column.begin(), column.end(), task_rng);
+    vector<RandomForest::ForestScore> permuted;
+    forest.score_batch_with_column(rows, feature, column, permuted, 1);
+    measure(permuted, accuracy[task], brier[task]);
+  }, num_threads);
+
+  result.accuracy_decrease.assign(num_features, 0.0);
+  result.accuracy_stddev.assign(num_features, 0.0);
+  result.brier_increase.assign(num_features, 0.0);
+  for (size_t f = 0; f < num_features; f++){
+    for (int r = 0; r < repeats; r++){
+      result.accuracy_decrease[f] += (result.baseline_accuracy - accuracy[f * repeats + r]) / repeats;
+      result.brier_increase[f] += (brier[f * repeats + r] - result.baseline_brier) / repeats;
+    }
+    double variance = 0.0;
+    for (int r = 0; r < repeats; r++){
+      double deviation = result.baseline_accuracy - accuracy[f * repeats + r] - result.accuracy_decrease[f];
+      variance += deviation * deviation / repeats;
+    }
+    result.accuracy_stddev[f] = sqrt(variance);
+  }
+  return result;
+}
+
+#endif  //FEATUREIMPORTANCE_H
@@ -0,0 +1,224 @@
+//FlatForest.h
+/**
+  *@file FlatForest.h
+  *@brief Header file for the FlatForest class, a flat structure-of-arrays forest scored several rows at a time with SIMD.
+  *Contain both declaraction and implementation
+*/
+
+#ifndef FLATFOREST_H
+#define FLATFOREST_H
+
+#include "DecisionTree.h"
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FLATFOREST_X86 1
+#endif
+
+using namespace std;
+
+/**
+  *@class FlatForest
+  *@brief Copy of a forest's nodes in flat arrays, traversed by several rows in lockstep.
+  *
+*Nodes of every tree are laid out breadth first with the two children of a split next to each other, so the next node is
+*left + !(x < threshold). A leaf has feature -1 and reuses the child and threshold slots for its label and leaf value.
+*The AVX2 kernel moves 8 rows and the AVX-512 kernel 16 rows through a tree at once, as two groups of 4 or 8 double lanes:
+*it gathers the node links, row values and thresholds by node index and computes the next node indexes with a masked
+*compare until every lane sits on a leaf. The kernel is picked at runtime from the CPU, with a scalar loop as fallback.
+*Leaves, and the order their values are summed in, are those of DecisionTree::find_leaf, so results are bit-identical.
+*/
+
+class FlatForest {
+public:
+  /// @brief Traversal kernel.
+  enum SimdLevel {
+    Scalar,               //< One row at a time.
+    AVX2,                 //< 8 rows per step.
+    AVX512                //< 16 rows per step.
+  };
+
+  static constexpr size_t kBlockRows = 64;     //< Rows copied into one contiguous buffer and sent through every tree together.
+
+  FlatForest() : num_features_(0) {}
+
+  explicit FlatForest(const vector<DecisionTree>& trees) : num_features_(0) {
+    for (const auto& tree : trees){
+      add_tree(tree.get_root());
+    }
+  }
+
+  size_t num_trees() const { return roots_.size(); }
+
+  /// @brief Best kernel the running CPU supports.
+  static SimdLevel detect(){
+#ifdef FLATFOREST_X86
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx2")) return AVX512;
+    if (__builtin_cpu_supports("avx2")) return AVX2;
+#endif
+    return Scalar;
+  }
+
+  /**
+    *@brief Votes for label 1 and summed leaf values of one row over every tree, in tree order.
+    *@param feature Vector of features. Extra trailing values (such as the label) are ignored.
+    */
+  void score(const vector<double>& feature, int& positive_votes, double& value_sum) const {
+    positive_votes = 0;
+    value_sum = 0.0;
+    for (int32_t root : roots_){
+      int32_t node = leaf_of(root, feature.data());
+      if (left_of(node) == 1) positive_votes++;
+      value_sum += threshold_[node];
+    }
+  }
+
+  /**
+    *@brief Scores rows[begin, end) block by block, writing the votes and value sums of row i to positive_votes[i - begin] and value_sums[i - begin].
+    *@param level Kernel to use, normally detect(). A level the CPU lacks must not be passed.
+    *@param column If set, feature @p feature of row i is read from column[i] instead, as it is copied into the block (permutation importance).
+    */
+  void score_rows(const vector<vector<double>>& rows, size_t begin, size_t end, int* positive_votes, double* value_sums, SimdLevel level,
+                  size_t feature = 0, const double* column = nullptr) const {
+    vector<double> block(kBlockRows * num_features_);
+    vector<int32_t> leaves(kBlockRows);
+    for (size_t first = begin; first < end; first += kBlockRows){
+      size_t count = min(kBlockRows, end - first);
+      for (size_t r = 0; r < count; r++){
+        copy(rows[first + r].begin(), rows[first + r].begin() + num_features_, block.begin() + r * num_features_);
+      }
+      if (column && feature < num_features_){
+        for (size_t r = 0; r < count; r++) block[r * num_features_ + feature] = column[first + r];
+      }
+      int* votes = positive_votes + (first - begin);
+      double* sums = value_sums + (first - begin);
+      fill(votes, votes + count, 0);
+      fill(sums, sums + count, 0.0);
+      for (int32_t root : roots_){
+        find_leaves(root, block.data(), count, leaves.data(), level);
+        for (size_t r = 0; r < count; r++){
+          if (left_of(leaves[r]) == 1) votes[r]++;
+          sums[r] += threshold_[leaves[r]];
+        }
+      }
+    }
+  }
+
+private:
+  void add_tree(const Node* root){
+    vector<const Node*> queue = {root};
+    size_t base = threshold_.size();
+    roots_.push_back(static_cast<int32_t>(base));
+    for (size_t i = 0; i < queue.size(); i++){
+      const Node* node = queue[i];
+      if (node->is_leaf){
+        links_.push_back(-1);
+        links_.push_back(node->label);
+        threshold_.push_back(node->value);
+        continue;
+      }
+      links_.push_back(node->feature_index);
+      links_.push_back(static_cast<int32_t>(base + queue.size()));
+      threshold_.push_back(node->threshold);
+      queue.push_back(node->left.get());
+      queue.push_back(node->right.get());
+      num_features_ = max(num_features_, static_cast<size_t>(node->feature_index) + 1);
+    }
+  }
+
+  int32_t feature_of(int32_t node) const { return links_[2 * node]; }
+  int32_t left_of(int32_t node) const { return links_[2 * node + 1]; }
+
+  int32_t leaf_of(int32_t node, const double* x) const {
+    while (feature_of(node) >= 0){
+      node = left_of(node) + !(x[feature_of(node)] < threshold_[node]);
+    }
+    return node;
+  }
+
+  void find_leaves(int32_t root, const double* block, size_t count, int32_t* leaves, SimdLevel level) const {
+    size_t r = 0;
+#ifdef FLATFOREST_X86
+    if (level == AVX512) for (; r + 16 <= count; r += 16) find_leaves_avx512(root, block + r * num_features_, leaves + r);
+    if (level != Scalar) for (; r + 8 <= count; r += 8) find_leaves_avx2(root, block + r * num_features_, leaves + r);
+#endif
+    for (; r < count; r++) leaves[r] = leaf_of(root, block + r * num_features_);
+  }
+
+#ifdef FLATFOREST_X86
+  //Both kernels step two independent groups of lanes per iteration so that one group's gathers overlap the other's.
+
+  /// @brief Moves 4 rows one level down; returns false once all of them are on leaves.
+  __attribute__((target("avx2"), always_inline))
+  inline bool step_avx2(__m128i& node, const double* rows, __m128i row_offset) const {
+    //one 64-bit gather fetches the feature (low half) and left child (high half) of every lane
+    //the masked gathers with a zeroed source and an all-ones mask are the plain gathers without an uninitialized source operand
+    const __m256i all = _mm256_set1_epi64x(-1);
+    __m256i link = _mm256_mask_i32gather_epi64(_mm256_setzero_si256(), reinterpret_cast<const long long*>(links_.data()), node, all, 8);
+    link = _mm256_permutevar8x32_epi32(link, _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7));
+    __m128i feature = _mm256_castsi256_si128(link);
+    __m128i active = _mm_cmpgt_epi32(feature, _mm_set1_epi32(-1));
+    if (_mm_movemask_epi8(active) == 0) return false;
+    //leaf lanes skip the row load, their feature index is -1
+    __m256d load_mask = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(active));
+    __m256d x = _mm256_mask_i32gather_pd(_mm256_setzero_pd(), rows, _mm_add_epi32(row_offset, feature), load_mask, 8);
+    __m256d threshold = _mm256_mask_i32gather_pd(_mm256_setzero_pd(), threshold_.data(), node, _mm256_castsi256_pd(all), 8);
+    __m256i right = _mm256_castpd_si256(_mm256_cmp_pd(x, threshold, _CMP_NLT_UQ));
+    __m128i right32 = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(right, _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6)));
+    __m128i next = _mm_sub_epi32(_mm256_extracti128_si256(link, 1), right32);
+    node = _mm_blendv_epi8(node, next, active);
+    return true;
+  }
+
+  __attribute__((target("avx2")))
+  void find_leaves_avx2(int32_t root, const double* rows, int32_t* leaves) const {
+    const int stride = static_cast<int>(num_features_);
+    const __m128i offset_a = _mm_setr_epi32(0, stride, 2 * stride, 3 * stride);
+    const __m128i offset_b = _mm_add_epi32(offset_a, _mm_set1_epi32(4 * stride));
+    __m128i node_a = _mm_set1_epi32(root), node_b = node_a;
+    while (step_avx2(node_a, rows, offset_a) | step_avx2(node_b, rows, offset_b)) {}
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(leaves), node_a);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(leaves + 4), node_b);
+  }
+
+  /// @brief Moves 8 rows one level down; returns false once all of them are on leaves.
+  __attribute__((target("avx512f,avx2"), always_inline))
+  inline bool step_avx512(__m256i& node, const double* rows, __m256i row_offset) const {
+    //zeroed sources and full masks throughout, for the same reason as in step_avx2
+    const __mmask8 all = 0xFF;
+    __m512i link = _mm512_mask_i32gather_epi64(_mm512_setzero_si512(), all, node, reinterpret_cast<const long long*>(links_.data()), 8);
+    __m256i feature = _mm512_maskz_cvtepi64_epi32(all, link);
+    __m256i active = _mm256_cmpgt_epi32(feature, _mm256_set1_epi32(-1));
+    __mmask8 active_mask = static_cast<__mmask8>(_mm256_movemask_ps(_mm256_castsi256_ps(active)));
+    if (active_mask == 0) return false;
+    __m512d x = _mm512_mask_i32gather_pd(_mm512_setzero_pd(), active_mask, _mm256_add_epi32(row_offset, feature), rows, 8);
+    __m512d threshold = _mm512_mask_i32gather_pd(_mm512_setzero_pd(), all, node, threshold_.data(), 8);
+    __mmask8 right = _mm512_cmp_pd_mask(x, threshold, _CMP_NLT_UQ);
+    __m256i left = _mm512_maskz_cvtepi64_epi32(all, _mm512_maskz_srli_epi64(all, link, 32));
+    __m256i next = _mm256_add_epi32(left, _mm512_maskz_cvtepi64_epi32(all, _mm512_maskz_set1_epi64(right, 1)));
+    node = _mm256_blendv_epi8(node, next, active);
+    return true;
+  }
+
+  __attribute__((target("avx512f,avx2")))
+  void find_leaves_avx512(int32_t root, const double* rows, int32_t* leaves) const {
+    const int stride = static_cast<int>(num_features_);
+    const __m256i offset_a = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(stride));
+    const __m256i offset_b = _mm256_add_epi32(offset_a, _mm256_set1_epi32(8 * stride));
+    __m256i node_a = _mm256_set1_epi32(root), node_b = node_a;
+    while (step_avx512(node_a, rows, offset_a) | step_avx512(node_b, rows, offset_b)) {}
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(leaves), node_a);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(leaves + 8), node_b);
+  }
+#endif
+
+  size_t num_features_;                     //< Row values copied per row, one past the largest split feature.
+  vector<int32_t> roots_;                   //< Root node of every tree.
+  vector<int32_t> links_;                   //< Per node: split feature (-1 for a leaf), then left child (the right child follows it) or the leaf label.
+  vector<double> threshold_;                //< Split threshold, or the leaf value.
+};
+
+#endif  //FLATFOREST_H
@@ -0,0 +1,349 @@
+#ifndef GRADIENTBOOSTING_H
+#define GRADIENTBOOSTING_H
+
+#include "DecisionTree.h"
+#include "Histogram.h"
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+/**
+  *@file GradientBoosting.h
+  *@brief Header file for the GradientBoosting class.
+  *Contian both declaration and implementation.
+  *
+  *A gradient boosted trees classifier with logistic loss on the label in the last column (not.fully.paid).
+  *Every round fits a shallow regression tree to the gradients on histograms of a BinnedMatrix, and the
+  *shrunken leaf values are stored in Node::value, so trees are plain DecisionTree objects that share the
+  *node layout and the model file format with RandomForest.
+  */
+
+/**
+  *@brief Training parameters of a GradientBoosting model.
+  */
+struct BoostingOptions {
+  int num_rounds = 100;                     //< Maximum number of boosting rounds (trees).
+  double learning_rate = 0.1;               //< Shrinkage applied to every leaf value.
+  int max_depth = 3;                        //< Depth of every regression tree.
+  size_t min_samples_leaf = 20;             //< Minimum number of rows in a leaf.
+  double min_child_weight = 1e-3;           //< Minimum hessian sum in a leaf.
+  double l2_regularization = 1.0;           //< L2 penalty (lambda) on leaf values.
+  double min_split_gain = 0.0;              //< Minimum loss reduction a split must achieve.
+  int max_bins = 256;                       //< Histogram bins per feature, at most 256.
+  double validation_fraction = 0.1;         //< Share of rows held out for early stopping, 0 to disable.
+  int early_stopping_rounds = 10;           //< Stop once the validation log-loss has not improved for this many rounds.
+  unsigned int seed = 5489u;                //< Seed of the train/validation split.
+  size_t num_threads = 0;                   //< Threads used for binning, histograms and batch scoring, 0 for the whole shared pool.
+  size_t parallel_split_min_samples = TreeOptions().parallel_split_min_samples; //< Nodes with at least this many rows build their feature histograms in parallel.
+};
+
+class GradientBoosting{
+public:
+  /**
+    *@brief Constructor that stores the training parameters.
+    *@param options Boosting parameters.
+    */
+  GradientBoosting(const BoostingOptions& options = BoostingOptions()): options_(options), base_score_(0.0), best_round_(0){}
+
+  /**
+    *@brief Trains the model on the provided dataset, holding out options.validation_fraction of it for early stopping.
+    *@param data_vec Rows where the last element is the 0/1 label.
+    */
+  void train(const vector<vector<double>>& data_vec){
+    LRP_LOG_INFO("boosting.train", "Starting gradient boosting on " << data_vec.size() << " rows");
+    vector<vector<double>> train_data, valid_data;
+    vector<size_t> indices(data_vec.size());
+    iota(indices.begin(), indices.end(), 0);
+    mt19937 rng(options_.seed);
+    shuffle(indices.begin(), indices.end(), rng);
+    size_t num_valid = options_.validation_fraction > 0 ? static_cast<size_t>(data_vec.size() * options_.validation_fraction) : 0;
+    for (size_t i = 0; i < indices.size(); i++){
+      (i < num_valid ? valid_data : train_data).push_back(data_vec[indices[i]]);
+    }
+
+    size_t num_features = data_vec[0].size() - 1;
+    vector<double> labels(train_data.size());
+    for (size_t i = 0; i < train_data.size(); i++) labels[i] = train_data[i].back();
+    BinnedMatrix binned(train_data, num_features, options_.max_bins, options_.num_threads);
+
+    double positive = accumulate(labels.begin(), labels.end(), 0.0) / labels.size();
+    positive = min(max(positive, 1e-6), 1 - 1e-6);
+    base_score_ = log(positive / (1 - positive));
+    trees_.clear();
+    validation_loss_.clear();
+
+    vector<double> scores(train_data.size(), base_score_), valid_scores(valid_data.size(), base_score_);
+    vector<double> gradients(train_data.size()), hessians(train_data.size());
+    double best_loss = numeric_limits<double>::max();
+    best_round_ = 0;
+
+    for (int round = 0; round < options_.num_rounds; round++){
+      for (size_t i = 0; i < scores.size(); i++){
+        double p = sigmoid(scores[i]);
+        gradients[i] = p - labels[i];
+        hessians[i] = max(p * (1 - p), 1e-16);
+      }
+      trees_.emplace_back(build_tree(binned, gradients, hessians, scores));
+
+      if (valid_data.empty()) continue;
+      double loss = 0.0;
+      for (size_t i = 0; i < valid_data.size(); i++){
+        valid_scores[i] += trees_.back().predict_value(valid_data[i]);
+        double p = min(max(sigmoid(valid_scores[i]), 1e-15), 1 - 1e-15);
+        double y = valid_data[i].back();
+        loss -= y * log(p) + (1 - y) * log(1 - p);
+      }
+      loss /= valid_data.size();
+      validation_loss_.push_back(loss);
+      if (loss < best_loss){
+        best_loss = loss;
+        best_round_ = round;
+      } else if (round - best_round_ >= options_.early_stopping_rounds){
+        break;
+      }
+    }
+    if (!valid_data.empty()) trees_.resize(best_round_ + 1);
+    LRP_LOG_INFO("boosting.train", "Boosting kept " << trees_.size() << " trees");
+  }
+
+  /**
+    *@brief Probability of the positive label for the given features.
+    */
+  double predict_proba(const vector<double>& feature) const {
+    double score = base_score_;
+    for (const auto& tree : trees_){
+      score += tree.predict_value(feature);
+    }
+    return sigmoid(score);
+  }
+
+  /**
+    *@brief Predicts the class label (1 if the positive probability is at least 0.5).
+    */
+  int predict(const vector<double>& feature) const {
+    return predict_proba(feature) >= 0.5 ? 1 : 0;
+  }
+
+  /**
+    *@brief Scores many rows on the shared pool; out is resized to rows.size().
+    */
+  void predict_proba_batch(const vector<vector<double>>& rows, vector<double>& out) const {
+    out.resize(rows.size());
+    ThreadPool::global().parallel_for(rows.size(), [&](size_t i){
+      out[i] = predict_proba(rows[i]);
+    }, options_.num_threads);
+  }
+
+  /**
+   * @brief Evaluates the accuracy of the model on a test dataset.
+   * @param test_data Rows where the last element is the label.
+   * @return The accuracy of predictions as a double.
+  */
+  double evaluate(const vector<vector<double>>& test_data) const {
+    vector<double> probabilities;
+    predict_proba_batch(test_data, probabilities);
+    int correct_predictions = 0;
+    for (size_t i = 0; i < test_data.size(); i++){
+      int predicted = probabilities[i] >= 0.5 ? 1 : 0;
+      if (predicted == static_cast<int>(test_data[i].back())) correct_predictions++;
+    }
+    return static_cast<double>(correct_predictions) / test_data.size();
+  }
+
+  /**
+   * @brief Writes the model in the model file format: a "GradientBoosting <num_trees> <base_score>" header followed by every tree (see DecisionTree::save).
+  */
+  void save(ostream& out) const {
+    out << setprecision(17) << "GradientBoosting " << trees_.size() << " " << base_score_ << "\n";
+    for (const auto& tree : trees_){
+      tree.save(out);
+    }
+  }
+
+  void save(const string& path) const {
+    ofstream out(path);
+    if (!out) throw runtime_error("Cannot open model file for writing: " + path);
+    save(out);
+  }
+
+  /**
+   * @brief Replaces the model with one read from a model file written by save.
+   * @throws runtime_error if the file is missing or malformed.
+  */
+  void load(istream& in){
+    string kind;
+    size_t num_trees = 0;
+    double base_score = 0.0;
+    if (!(in >> kind >> num_trees >> base_score) || kind != "GradientBoosting") throw runtime_error("Not a GradientBoosting model file.");
+    in.ignore(numeric_limits<streamsize>::max(), '\n');
+    //the header's count is not trusted for an allocation: a truncated or corrupt file runs out of trees first
+    vector<DecisionTree> trees;
+    for (size_t t = 0; t < num_trees; t++){
+      trees.emplace_back();
+      trees.back().load(in);
+    }
+    base_score_ = base_score;
+    trees_ = move(trees);
+  }
+
+  void load(const string& path){
+    ifstream in(path);
+    if (!in) throw runtime_error("Cannot open model file: " + path);
+    load(in);
+  }
+
+  /// @brief Returns the boosted trees, for code that walks the model.
+  const vector<DecisionTree>& get_trees() const { return trees_; }
+
+  /// @brief Raw score every prediction starts from (log-odds of the training labels).
+  double get_base_score() const { return base_score_; }
+
+  /// @brief Validation log-loss after every round that was trained.
+  const vector<double>& get_validation_loss() const { return validation_loss_; }
+
+  static double sigmoid(double x){ return 1.0 / (1.0 + exp(-x)); }
+
+private:
+  struct OpenNode {               //< A node waiting to be split, covering rows[start, end).
+    Node* node;
+    size_t start;
+    size_t end;
+    int depth;
+  };
+
+  struct NodeSplit {              //< Best histogram split of a node.
+    bool split = false;
+    int feature_index = -1;
+    int bin = -1;                 //< Rows with bin <= this go left.
+    double gradient_sum = 0.0;
+    double hessian_sum = 0.0;
+  };
+
+  struct BinStats {
+    double gradient = 0.0;
+    double hessian = 0.0;
+    size_t count = 0;
+  };
+
+  /**
+    *@brief Grows one regression tree level by level and adds its leaf values to the training scores.
+    */
+  NodePtr build_tree(const BinnedMatrix& binned, const vector<double>& gradients, const vector<double>& hessians, vector<double>& scores){
+    NodePtr root(new Node());
+    vector<size_t> rows(binned.num_rows());
+    iota(rows.begin(), rows.end(), 0);
+    ThreadPool& pool = ThreadPool::global();
+
+    vector<OpenNode> level = {{root.get(), 0, rows.size(), 0}};
+    while (!level.empty()){
+      vector<NodeSplit> splits(level.size());
+      pool.parallel_for(level.size(), [&](size_t i){
+        splits[i] = find_split(binned, gradients, hessians, rows, level[i]);
+      }, options_.num_threads);
+
+      vector<OpenNode> next_level;
+      for (size_t i = 0; i < level.size(); i++){
+        const OpenNode& open = level[i];
+        Node* node = open.node;
+        const NodeSplit& split = splits[i];
+        if (!split.split){
+          node->is_leaf = true;
+          node->value = -split.gradient_sum / (split.hessian_sum + options_.l2_regularization) * options_.learning_rate;
+          for (size_t r = open.start; r < open.end; r++) scores[rows[r]] += node->value;
+          continue;
+        }
+        node->feature_index = split.feature_index;
+        node->threshold = binned.cuts(split.feature_index)[split.bin];
+        node->left.reset(new Node());
+        node->right.reset(new Node());
+        const vector<uint8_t>& column = binned.column(split.feature_index);
+        size_t mid = open.start;
+        for (size_t r = open.start; r < open.end; r++){
+          if (column[rows[r]] <= split.bin) swap(rows[mid++], rows[r]);
+        }
+        next_level.push_back({node->left.get(), open.start, mid, open.depth + 1});
+        next_level.push_back({node->right.get(), mid, open.end, open.depth + 1});
+      }
+      level.swap(next_level);
+    }
+    return root;
+  }
+
+  NodeSplit find_split(const BinnedMatrix& binned, const vector<double>& gradients, const vector<double>& hessians, const vector<size_t>& rows, const OpenNode& open){
+    NodeSplit best;
+    for (size_t r = open.start; r < open.end; r++){
+      best.gradient_sum += gradients[rows[r]];
+      best.hessian_sum += hessians[rows[r]];
+    }
+    size_t num_samples = open.end - open.start;
+    if (open.depth >= options_.max_depth || num_samples < 2 * options_.min_samples_leaf) return best;
+
+    double lambda = options_.l2_regularization;
+    double parent = best.gradient_sum * best.gradient_sum / (best.hessian_sum + lambda);
+    size_t num_features = binned.num_features();
+    vector<double> feature_gain(num_features, options_.min_split_gain);
+    vector<int> feature_bin(num_features, -1);
+
+    //one histogram per feature, built in a single pass over the node's rows; large nodes fan features out
+    auto search_feature = [&](size_t f){
+      vector<BinStats> histogram(binned.num_bins(f));
+      const vector<uint8_t>& column = binned.column(f);
+      for (size_t r = open.start; r < open.end; r++){
+        BinStats& bin = histogram[column[rows[r]]];
+        bin.gradient += gradients[rows[r]];
+        bin.hessian += hessians[rows[r]];
+        bin.count++;
+      }
+      BinStats left;
+      for (size_t b = 0; b + 1 < histogram.size(); b++){
+        left.gradient += histogram[b].gradient;
+        left.hessian += histogram[b].hessian;
+        left.count += histogram[b].count;
+        double right_gradient = best.gradient_sum - left.gradient;
+        double right_hessian = best.hessian_sum - left.hessian;
+        size_t right_count = num_samples - left.count;
+        if (left.count < options_.min_samples_leaf || right_count < options_.min_samples_leaf) continue;
+        if (left.hessian < options_.min_child_weight || right_hessian < options_.min_child_weight) continue;
+        double gain = left.gradient * left.gradient / (left.hessian + lambda)
+                    + right_gradient * right_gradient / (right_hessian + lambda) - parent;
+        if (gain > feature_gain[f]){
+          feature_gain[f] = gain;
+          feature_bin[f] = b;
+        }
+      }
+    };
+    if (num_samples >= options_.parallel_split_min_samples){
+      ThreadPool::global().parallel_for(num_features, search_feature, options_.num_threads);
+    } else {
+      for (size_t f = 0; f < num_features; f++) search_feature(f);
+    }
+
+    double best_gain = options_.min_split_gain;
+    for (size_t f = 0; f < num_features; f++){
+      if (feature_bin[f] >= 0 && feature_gain[f] > best_gain){
+        best_gain = feature_gain[f];
+        best.split = true;
+        best.feature_index = f;
+        best.bin = feature_bin[f];
+      }
+    }
+    return best;
+  }
+
+  BoostingOptions options_;
+  double base_score_;
+  int best_round_;
+  vector<DecisionTree> trees_;
+  vector<double> validation_loss_;
+};
+
+#endif  //GRADIENTBOOSTING_H
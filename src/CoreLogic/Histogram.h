@@ -0,0 +1,106 @@
+//Histogram.h
+/**
+  *@file Histogram.h
+  *@brief Header file for the BinnedMatrix class used by histogram based training.
+  *Contain both declaraction and implementation
+*/
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include "../Includes/ThreadPool.h"
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+
+using namespace std;
+
+/**
+  *@class BinnedMatrix
+  *@brief Column-major copy of a feature matrix where every value is replaced by a small bin index.
+  *
+*Every feature gets a sorted table of cut values taken from its own data. A value x falls in bin
+*b = number of cuts <= x, so "bin <= k" is exactly "x < cuts[k]", the same test Node uses with threshold cuts[k].
+*Features with fewer distinct values than max_bins get one bin per value, so splits are as exact as a sorted scan.
+*Split search then works on per-bin histograms of one byte per row and feature instead of sorting doubles.
+*/
+
+class BinnedMatrix {
+public:
+  BinnedMatrix() : num_rows_(0) {}
+
+  /**
+    *@brief Bins the first @p num_features values of every row.
+    *@param data Row-major data. Extra trailing values (such as the label) are ignored.
+    *@param num_features Number of feature columns to bin.
+    *@param max_bins Maximum bins per feature, at most 256.
+    *@param num_threads Threads used to bin the columns, 0 for the whole shared pool.
+    *@param cut_rows Indexes of the rows the cuts are computed from, nullptr for every row. Every row is binned either way.
+    */
+  BinnedMatrix(const vector<vector<double>>& data, size_t num_features, int max_bins = 256, size_t num_threads = 0,
+               const vector<size_t>* cut_rows = nullptr) : num_rows_(data.size()) {
+    if (max_bins < 2 || max_bins > 256) throw invalid_argument("max_bins must be between 2 and 256.");
+    cuts_.resize(num_features);
+    bins_.resize(num_features);
+    ThreadPool::global().parallel_for(num_features, [&](size_t f){
+      vector<double> column;
+      if (cut_rows){
+        column.reserve(cut_rows->size());
+        for (size_t i : *cut_rows) column.push_back(data[i][f]);
+      } else {
+        column.resize(data.size());
+        for (size_t i = 0; i < data.size(); i++) column[i] = data[i][f];
+      }
+      cuts_[f] = compute_cuts(column, max_bins);
+      bins_[f].resize(data.size());
+      for (size_t i = 0; i < data.size(); i++) bins_[f][i] = bin_of(f, data[i][f]);
+    }, num_threads);
+  }
+
+  /// @brief Bin index of value @p x for feature @p feature.
+  uint8_t bin_of(size_t feature, double x) const {
+    const vector<double>& cuts = cuts_[feature];
+    return static_cast<uint8_t>(upper_bound(cuts.begin(), cuts.end(), x) - cuts.begin());
+  }
+
+  /// @brief Bin indexes of one feature for every row.
+  const vector<uint8_t>& column(size_t feature) const { return bins_[feature]; }
+
+  /// @brief Sorted cut values of a feature; bin k holds values in [cuts[k-1], cuts[k]).
+  const vector<double>& cuts(size_t feature) const { return cuts_[feature]; }
+
+  /// @brief Number of bins of a feature (cuts + 1).
+  size_t num_bins(size_t feature) const { return cuts_[feature].size() + 1; }
+
+  size_t num_rows() const { return num_rows_; }
+  size_t num_features() const { return cuts_.size(); }
+
+  /**
+    *@brief Cut values for one column: every distinct value but the smallest if they fit, otherwise quantiles of the data.
+    */
+  static vector<double> compute_cuts(vector<double> column, int max_bins){
+    sort(column.begin(), column.end());
+    vector<double> distinct;
+    for (double value : column){
+      if (distinct.empty() || value != distinct.back()) distinct.push_back(value);
+    }
+    vector<double> cuts;
+    if (distinct.size() <= static_cast<size_t>(max_bins)){
+      cuts.assign(distinct.begin() + (distinct.empty() ? 0 : 1), distinct.end());
+      return cuts;
+    }
+    for (int k = 1; k < max_bins; k++){
+      double value = column[column.size() * k / max_bins];
+      if (value > column.front() && (cuts.empty() || value > cuts.back())) cuts.push_back(value);
+    }
+    return cuts;
+  }
+
+private:
+  size_t num_rows_;
+  vector<vector<double>> cuts_;             //< Per-feature sorted cut values.
+  vector<vector<uint8_t>> bins_;            //< Per-feature bin index of every row (column-major).
+};
+
+#endif  //HISTOGRAM_H
@@ -0,0 +1,302 @@
+//HoeffdingTree.h
+/**
+  *@file HoeffdingTree.h
+  *@brief Header file for the HoeffdingTree class
+  *Contain both declaraction and implementation
+*/
+
+#ifndef HOEFFDINGTREE_H
+#define HOEFFDINGTREE_H
+
+#include "Node.h"
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <unordered_map>
+#include <cmath>
+
+using namespace std;
+
+/**
+  *@class HoeffdingTree
+  *@brief Streaming (VFDT style) decision tree learner.
+  *
+*Unlike DecisionTree, which needs the whole dataset in memory to build, this tree consumes rows one at a time.
+*Every active leaf keeps a bounded amount of sufficient statistics (a Gaussian estimator per class and feature),
+*and a leaf is split once the Hoeffding bound says the best split is better than the runner-up with confidence 1 - delta.
+*Memory therefore depends on the number of leaves and features, never on the number of rows seen.
+*Prediction uses the same Node structure and interface as DecisionTree::predict.
+*/
+
+class HoeffdingTree {
+public:
+  /**
+    *@brief Constructor for a streaming tree.
+    *@param delta Allowed probability of choosing the wrong split at a leaf.
+    *@param grace_period Number of rows a leaf accumulates between split attempts.
+    *@param tie_threshold Split anyway once the Hoeffding bound falls below this value (the candidates are tied).
+    *@param num_candidate_splits Number of thresholds evaluated per feature between its observed min and max.
+    *@param max_active_leaves Leaves created beyond this limit are frozen and stop collecting statistics.
+    */
+  HoeffdingTree(double delta = 1e-7, int grace_period = 200, double tie_threshold = 0.05, int num_candidate_splits = 10, size_t max_active_leaves = 1024)
+    : root(new Node()), delta_(delta), grace_period_(grace_period), tie_threshold_(tie_threshold),
+      num_candidate_splits_(num_candidate_splits), max_active_leaves_(max_active_leaves), rows_seen_(0) {
+    root->is_leaf = true;
+    leaf_stats_[root.get()] = LeafStatistics();
+  }
+
+  /**
+    *@brief Feeds every row of a dataset to the tree, in order.
+    *@param data_vec Rows where the last element is the label.
+    */
+  void train(const vector<vector<double>>& data_vec){
+    for (const auto& row : data_vec){
+      update(row);
+    }
+  }
+
+  /**
+    *@brief Learns from a single row where the last element is the label.
+    */
+  void update(const vector<double>& row){
+    learn(row, row.size() - 1, static_cast<int>(row.back()));
+  }
+
+  /**
+    *@brief Learns from a single row.
+    *@param feature Feature values of the row. The first row fixes the number of features; extra trailing values in later rows are ignored.
+    *@param label Class label of the row.
+    */
+  void update(const vector<double>& feature, int label){
+    learn(feature, feature.size(), label);
+  }
+
+  int predict(const vector<double>& feature, bool verbose = false){                              //< predicts the class label for the given features.
+    Node* node = root.get();
+    if (verbose) cout << "Starting at root " <<endl;
+    while (!node->is_leaf){
+      if (verbose){
+      cout << "At Node: Feature index = " << node->feature_index
+      << ", Threshold = " << node->threshold
+      << ", Current Feature Value = " <<feature[node->feature_index] << endl;
+      }
+      node = (feature[node->feature_index] < node->threshold) ? node->left.get() : node->right.get();
+    }
+    if (verbose) {
+      cout << "Reach leaf: Predicted Label = " << node->label << endl;
+    }
+    return node->label;
+  }
+
+  /// @brief Root of the tree, for inspecting its splits.
+  const Node* get_root() const { return root.get(); }
+
+  /// @brief Number of rows consumed so far.
+  size_t get_rows_seen() const { return rows_seen_; }
+
+  /// @brief Number of leaves still collecting statistics.
+  size_t get_active_leaf_count() const { return leaf_stats_.size(); }
+
+  /**
+    *@brief The Hoeffding bound for a statistic with range @p range after @p n observations.
+    */
+  static double hoeffding_bound(double range, double delta, double n){
+    return sqrt(range * range * log(1.0 / delta) / (2.0 * n));
+  }
+
+private:
+  /**
+    *@brief Adds a row to the statistics of its leaf and attempts a split once the grace period has passed.
+    *@param num_features Leading values of @p feature that are features; the first row fixes num_features_ from it.
+    */
+  void learn(const vector<double>& feature, size_t num_features, int label){
+    rows_seen_++;
+    Node* leaf = find_leaf(feature);
+    auto it = leaf_stats_.find(leaf);
+    if (it == leaf_stats_.end()) return;          //frozen leaf, keeps its label
+    LeafStatistics& stats = it->second;
+
+    if (num_features_ == 0) num_features_ = num_features;
+    ClassStatistics& class_stats = stats.classes[label];
+    if (class_stats.features.empty()) class_stats.features.resize(num_features_);
+    class_stats.count++;
+    for (size_t f = 0; f < num_features_; f++){
+      class_stats.features[f].add(feature[f]);
+    }
+    stats.total++;
+    leaf->label = stats.majority_label();
+
+    if (stats.total - stats.total_at_last_attempt >= grace_period_ && stats.classes.size() > 1){
+      stats.total_at_last_attempt = stats.total;
+      attempt_split(leaf, stats);
+    }
+  }
+
+  /// @brief Running mean/variance (Welford) and range of one feature for one class.
+  struct GaussianEstimator {
+    double weight = 0.0;
+    double mean = 0.0;
+    double m2 = 0.0;
+    double min = numeric_limits<double>::max();
+    double max = numeric_limits<double>::lowest();
+
+    void add(double x){
+      weight++;
+      double d = x - mean;
+      mean += d / weight;
+      m2 += d * (x - mean);
+      if (x < min) min = x;
+      if (x > max) max = x;
+    }
+
+    /// @brief Estimated number of observations strictly below @p x.
+    double count_below(double x) const {
+      if (weight == 0 || x <= min) return 0.0;
+      if (x > max) return weight;
+      double variance = weight > 1 ? m2 / (weight - 1) : 0.0;
+      if (variance <= 0) return x > mean ? weight : 0.0;
+      double z = (x - mean) / sqrt(2.0 * variance);
+      return weight * 0.5 * (1.0 + erf(z));
+    }
+  };
+
+  struct ClassStatistics {
+    double count = 0.0;
+    vector<GaussianEstimator> features;
+  };
+
+  /// @brief Sufficient statistics of an active leaf, O(classes * features) regardless of rows seen.
+  struct LeafStatistics {
+    map<int, ClassStatistics> classes;
+    double total = 0.0;
+    double total_at_last_attempt = 0.0;
+
+    int majority_label() const {
+      int majority_label = -1;
+      double max_count = 0;
+      for (const auto& pair : classes){
+        if (pair.second.count > max_count){
+          max_count = pair.second.count;
+          majority_label = pair.first;
+        }
+      }
+      return majority_label;
+    }
+  };
+
+  struct Candidate {
+    double gini = numeric_limits<double>::max();
+    double threshold = 0.0;
+    int feature_index = -1;
+    map<int, double> left_counts, right_counts;
+  };
+
+  Node* find_leaf(const vector<double>& feature){
+    Node* node = root.get();
+    while (!node->is_leaf){
+      node = (feature[node->feature_index] < node->threshold) ? node->left.get() : node->right.get();
+    }
+    return node;
+  }
+
+  static double weighted_gini(const map<int, double>& left_counts, const map<int, double>& right_counts){
+    double left_size = 0, right_size = 0;
+    for (const auto& pair : left_counts) left_size += pair.second;
+    for (const auto& pair : right_counts) right_size += pair.second;
+    if (left_size <= 0 || right_size <= 0) return numeric_limits<double>::max();
+
+    double left_gini = 1.0, right_gini = 1.0;
+    for (const auto& pair : left_counts){
+      double p = pair.second / left_size;
+      left_gini -= p * p;
+    }
+    for (const auto& pair : right_counts){
+      double p = pair.second / right_size;
+      right_gini -= p * p;
+    }
+    return (left_gini * left_size + right_gini * right_size) / (left_size + right_size);
+  }
+
+  void attempt_split(Node* leaf, LeafStatistics& stats){
+    Candidate best, second;
+    for (size_t f = 0; f < num_features_; f++){
+      double lo = numeric_limits<double>::max(), hi = numeric_limits<double>::lowest();
+      for (const auto& pair : stats.classes){
+        lo = min(lo, pair.second.features[f].min);
+        hi = max(hi, pair.second.features[f].max);
+      }
+      if (!(lo < hi)) continue;
+
+      //best threshold for this feature; only the best per feature competes for the bound
+      Candidate feature_best;
+      for (int i = 1; i <= num_candidate_splits_; i++){
+        Candidate candidate;
+        candidate.feature_index = f;
+        candidate.threshold = lo + (hi - lo) * i / (num_candidate_splits_ + 1);
+        for (const auto& pair : stats.classes){
+          double below = pair.second.features[f].count_below(candidate.threshold);
+          candidate.left_counts[pair.first] = below;
+          candidate.right_counts[pair.first] = pair.second.count - below;
+        }
+        candidate.gini = weighted_gini(candidate.left_counts, candidate.right_counts);
+        if (candidate.gini < feature_best.gini) feature_best = candidate;
+      }
+      if (feature_best.gini < best.gini){
+        second = best;
+        best = feature_best;
+      } else if (feature_best.gini < second.gini){
+        second = feature_best;
+      }
+    }
+    if (best.feature_index < 0) return;
+
+    double node_gini = 1.0;
+    for (const auto& pair : stats.classes){
+      double p = pair.second.count / stats.total;
+      node_gini -= p * p;
+    }
+    //a single candidate competes against not splitting at all
+    double runner_up = min(second.gini, node_gini);
+    double epsilon = hoeffding_bound(1.0, delta_, stats.total);
+    if (best.gini >= node_gini) return;
+    if (runner_up - best.gini <= epsilon && epsilon >= tie_threshold_) return;
+
+    leaf->is_leaf = false;
+    leaf->feature_index = best.feature_index;
+    leaf->threshold = best.threshold;
+    leaf->gini_index = best.gini;
+    leaf->left.reset(new Node());
+    leaf->right.reset(new Node());
+    leaf_stats_.erase(leaf);                      //invalidates stats
+    make_leaf(leaf->left.get(), best.left_counts);
+    make_leaf(leaf->right.get(), best.right_counts);
+  }
+
+  void make_leaf(Node* node, const map<int, double>& estimated_counts){
+    node->is_leaf = true;
+    double max_count = -1;
+    for (const auto& pair : estimated_counts){
+      if (pair.second > max_count){
+        max_count = pair.second;
+        node->label = pair.first;
+      }
+    }
+    if (leaf_stats_.size() < max_active_leaves_){
+      leaf_stats_[node] = LeafStatistics();
+    }
+  }
+
+  NodePtr root;                                                 //< Unique pointer to the root node of the tree
+  unordered_map<Node*, LeafStatistics> leaf_stats_;               //< Statistics of the leaves that are still learning
+  double delta_;
+  double grace_period_;
+  double tie_threshold_;
+  int num_candidate_splits_;
+  size_t max_active_leaves_;
+  size_t num_features_ = 0;
+  size_t rows_seen_;
+};
+
+#endif  //HOEFFDINGTREE_H
@@ -0,0 +1,297 @@
+//HyperparameterSearch.h
+/**
+  *@file HyperparameterSearch.h
+  *@brief Header file for the grid and random hyperparameter search over RandomForest settings
+  *Contain both declaraction and implementation
+*/
+
+#ifndef HYPERPARAMETERSEARCH_H
+#define HYPERPARAMETERSEARCH_H
+
+#include "RandomForest.h"
+#include "../Includes/ThreadPool.h"
+#include "../Includes/Instrumentation.h"
+#include "../Includes/Logger.h"
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <cmath>
+#include <numeric>
+#include <ostream>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+
+using namespace std;
+
+/**
+  *@brief One configuration to evaluate: forest size, bootstrap and tree options.
+  */
+struct SearchTrial {
+  int num_trees = 100;
+  bool bootstrap = true;
+  TreeOptions options = RandomForest::default_tree_options();
+
+  /// @brief Key used to skip duplicate configurations.
+  tuple<int, bool, int, size_t, size_t, int, double, int, double, int, int> key() const {
+    return make_tuple(num_trees, bootstrap, options.max_depth, options.min_samples_split, options.min_samples_leaf, options.max_leaf_nodes,
+                      options.min_impurity_decrease, (int)options.max_features.kind, options.max_features.value, (int)options.split_mode, options.max_bins);
+  }
+};
+
+/**
+  *@brief Candidate values of every hyperparameter. A list with one value keeps that setting fixed.
+  */
+struct SearchSpace {
+  vector<int> num_trees = {100};
+  vector<int> max_depth = {-1};
+  vector<size_t> min_samples_split = {2};
+  vector<size_t> min_samples_leaf = {1};
+  vector<int> max_leaf_nodes = {-1};
+  vector<double> min_impurity_decrease = {0.0};
+  vector<MaxFeatures> max_features = {RandomForest::default_tree_options().max_features};
+  vector<SplitMode> split_mode = {BestSplit};
+  vector<bool> bootstrap = {true};
+  vector<int> max_bins = {0};
+
+  /// @brief Number of configurations in the full grid.
+  size_t grid_size() const {
+    return num_trees.size() * max_depth.size() * min_samples_split.size() * min_samples_leaf.size() * max_leaf_nodes.size()
+         * min_impurity_decrease.size() * max_features.size() * split_mode.size() * bootstrap.size() * max_bins.size();
+  }
+
+  /**
+    *@brief Every combination of the candidate values (grid search).
+    *@param base Options the searched fields are written over, e.g. huge_pages.
+    */
+  vector<SearchTrial> grid(const TreeOptions& base = RandomForest::default_tree_options()) const {
+    vector<SearchTrial> trials;
+    size_t total = grid_size();
+    trials.reserve(total);
+    for (size_t index = 0; index < total; index++){
+      size_t rest = index;                    //index as a mixed-radix number, one digit per field
+      trials.push_back(make_trial(base, [&](size_t count){
+        size_t pick = rest % count;
+        rest /= count;
+        return pick;
+      }));
+    }
+    return trials;
+  }
+
+  /**
+    *@brief @p count distinct configurations with every value drawn uniformly from its list (random search), the whole grid if it is smaller.
+    */
+  vector<SearchTrial> sample(size_t count, mt19937& rng, const TreeOptions& base = RandomForest::default_tree_options()) const {
+    if (count >= grid_size()) return grid(base);
+    vector<SearchTrial> trials;
+    set<decltype(SearchTrial().key())> seen;
+    while (trials.size() < count){
+      SearchTrial trial = make_trial(base, [&](size_t size){ return uniform_int_distribution<size_t>(0, size - 1)(rng); });
+      if (seen.insert(trial.key()).second) trials.push_back(trial);
+    }
+    return trials;
+  }
+
+private:
+  /// @brief Builds one trial, pick(n) choosing which of the n candidates of every field to use.
+  template <typename Pick>
+  SearchTrial make_trial(const TreeOptions& base, Pick&& pick) const {
+    if (grid_size() == 0) throw invalid_argument("Every hyperparameter needs at least one candidate value.");
+    SearchTrial trial;
+    trial.options = base;
+    trial.num_trees = num_trees[pick(num_trees.size())];
+    trial.options.max_depth = max_depth[pick(max_depth.size())];
+    trial.options.min_samples_split = min_samples_split[pick(min_samples_split.size())];
+    trial.options.min_samples_leaf = min_samples_leaf[pick(min_samples_leaf.size())];
+    trial.options.max_leaf_nodes = max_leaf_nodes[pick(max_leaf_nodes.size())];
+    trial.options.min_impurity_decrease = min_impurity_decrease[pick(min_impurity_decrease.size())];
+    trial.options.max_features = max_features[pick(max_features.size())];
+    trial.options.split_mode = split_mode[pick(split_mode.size())];
+    trial.bootstrap = bootstrap[pick(bootstrap.size())];
+    trial.options.max_bins = max_bins[pick(max_bins.size())];
+    return trial;
+  }
+};
+
+/**
+  *@brief Cross-validated score and cost of one configuration.
+  */
+struct TrialResult {
+  SearchTrial trial;
+  double accuracy = 0.0;                    //< Mean accuracy over the folds, between 0 and 1.
+  double accuracy_stddev = 0.0;             //< Standard deviation of the fold accuracies.
+  double train_seconds = 0.0;               //< Training time summed over the folds.
+  double predict_seconds = 0.0;             //< Scoring time of the held-out rows summed over the folds.
+};
+
+/**
+  *@class HyperparameterSearch
+  *@brief Cross-validates many RandomForest configurations on one dataset.
+  *
+*Everything that does not depend on the configuration is prepared once and shared by every trial: the fold assignment,
+*the held-out rows of every fold, per fold the bootstrap row indexes and feature seeds of every tree, and for histogram
+*splits the quantized dataset (one BinnedMatrix per max_bins value and fold, whose cuts come from the fold's training rows only, so
+*the held-out rows do not shape the bins they are scored against and the scores are not biased upwards). Trials read the
+*dataset in place through row indexes instead of copying training sets, trials differing only in tree settings see the same
+*samples (so their scores differ by the settings, not by sampling noise), and a forest of n trees reuses the first n samples
+*of a larger one. (trial, fold) pairs are scheduled on the shared pool, each trained serially, which keeps every thread busy
+*without nesting parallel loops inside small forests.
+*/
+class HyperparameterSearch {
+public:
+  /**
+    *@param data Rows with the label last. Must outlive the search.
+    *@param folds Number of cross-validation folds, at least 2.
+    *@param seed Seeds the folds, samples and trees, so results are reproducible.
+    */
+  HyperparameterSearch(const vector<vector<double>>& data, int folds, unsigned int seed = 5489u) : data_(data), rng_(seed) {
+    if (folds < 2 || data.size() < (size_t)folds) throw invalid_argument("Cross-validation needs at least 2 folds and a row per fold.");
+    vector<size_t> indices(data.size());
+    iota(indices.begin(), indices.end(), 0);
+    shuffle(indices.begin(), indices.end(), rng_);
+    folds_.resize(folds);
+    size_t fold_size = data.size() / folds;
+    for (int f = 0; f < folds; f++){
+      size_t start = f * fold_size;
+      size_t end = f == folds - 1 ? data.size() : start + fold_size;       //the last fold takes the remaining rows
+      Fold& fold = folds_[f];
+      for (size_t j = 0; j < indices.size(); j++){
+        if (j >= start && j < end) fold.test_rows.push_back(data[indices[j]]);
+        else fold.train_rows.push_back(indices[j]);
+      }
+      fold.all_rows.push_back(fold.train_rows);
+    }
+  }
+
+  /// @brief Number of cross-validation folds.
+  size_t num_folds() const { return folds_.size(); }
+
+  /**
+    *@brief Cross-validates every trial.
+    *@param num_threads Threads working on (trial, fold) pairs, 0 for the whole shared pool.
+    *@return One result per trial, in the order of @p trials.
+    */
+  vector<TrialResult> run(const vector<SearchTrial>& trials, size_t num_threads = 0){
+    LRP_PHASE("search.run");
+    int max_trees = 0;
+    for (const SearchTrial& trial : trials) max_trees = max(max_trees, trial.num_trees);
+    prepare_samples(max_trees);
+    for (const SearchTrial& trial : trials){
+      int bins = trial.options.max_bins;
+      if (bins > 0 && trial.options.split_mode == BestSplit && !binned_.count(bins)){
+        LRP_PHASE("search.bin");
+        vector<unique_ptr<BinnedMatrix>>& per_fold = binned_[bins];
+        for (const Fold& fold : folds_){
+          per_fold.emplace_back(new BinnedMatrix(data_, data_[0].size() - 1, bins, num_threads, &fold.train_rows));
+        }
+      }
+    }
+
+    struct FoldScore {
+      double accuracy = 0.0, train_seconds = 0.0, predict_seconds = 0.0;
+    };
+    const size_t num_folds = folds_.size();
+    vector<FoldScore> scores(trials.size() * num_folds);
+    ThreadPool::global().parallel_for(scores.size(), [&](size_t task){
+      const SearchTrial& trial = trials[task / num_folds];
+      const Fold& fold = folds_[task % num_folds];
+      TreeOptions options = trial.options;
+      options.num_threads = 1;                //parallelism comes from running trials side by side
+      RandomForest forest(trial.num_trees, options);
+      auto start = chrono::steady_clock::now();
+      auto binned = binned_.find(trial.options.max_bins);
+      forest.train_on_samples(data_, trial.bootstrap ? fold.bootstrap_rows : fold.all_rows, fold.tree_seeds,
+                              binned == binned_.end() ? nullptr : binned->second[task % num_folds].get());
+      auto trained = chrono::steady_clock::now();
+      vector<RandomForest::ForestScore> results;
+      forest.score_batch(fold.test_rows, results, 1);
+      auto scored = chrono::steady_clock::now();
+      size_t correct = 0;
+      for (size_t i = 0; i < results.size(); i++){
+        if (results[i].prediction() == static_cast<int>(fold.test_rows[i].back())) correct++;
+      }
+      FoldScore& score = scores[task];
+      score.accuracy = correct / (double)fold.test_rows.size();
+      score.train_seconds = chrono::duration<double>(trained - start).count();
+      score.predict_seconds = chrono::duration<double>(scored - trained).count();
+      LRP_LOG_DEBUG("search.trial", "Trial " << task / num_folds + 1 << " fold " << task % num_folds + 1 << ": accuracy " << score.accuracy);
+    }, num_threads);
+
+    vector<TrialResult> results(trials.size());
+    for (size_t t = 0; t < trials.size(); t++){
+      TrialResult& result = results[t];
+      result.trial = trials[t];
+      for (size_t f = 0; f < num_folds; f++){
+        const FoldScore& score = scores[t * num_folds + f];
+        result.accuracy += score.accuracy / num_folds;
+        result.train_seconds += score.train_seconds;
+        result.predict_seconds += score.predict_seconds;
+      }
+      double variance = 0.0;
+      for (size_t f = 0; f < num_folds; f++){
+        double deviation = scores[t * num_folds + f].accuracy - result.accuracy;
+        variance += deviation * deviation / num_folds;
+      }
+      result.accuracy_stddev = sqrt(variance);
+    }
+    return results;
+  }
+
+  /**
+    *@brief Writes the results as CSV, one row per trial, best accuracy first.
+    */
+  static void write_table(ostream& out, vector<TrialResult> results){
+    stable_sort(results.begin(), results.end(), [](const TrialResult& a, const TrialResult& b){ return a.accuracy > b.accuracy; });
+    out << "num_trees,max_depth,min_samples_split,min_samples_leaf,max_leaf_nodes,min_impurity_decrease,max_features,split,bootstrap,max_bins,"
+        << "accuracy,accuracy_stddev,train_seconds,predict_seconds\n";
+    for (const TrialResult& result : results){
+      const TreeOptions& options = result.trial.options;
+      out << result.trial.num_trees << "," << options.max_depth << "," << options.min_samples_split << "," << options.min_samples_leaf << ","
+          << options.max_leaf_nodes << "," << options.min_impurity_decrease << "," << options.max_features.describe() << ","
+          << (options.split_mode == RandomSplit ? "random" : "best") << "," << (result.trial.bootstrap ? "true" : "false") << "," << options.max_bins << ","
+          << result.accuracy << "," << result.accuracy_stddev << "," << result.train_seconds << "," << result.predict_seconds << "\n";
+    }
+  }
+
+private:
+  struct Fold {
+    vector<size_t> train_rows;                      //< Indexes into data_ of the rows the fold trains on.
+    vector<vector<double>> test_rows;               //< Copy of the held-out rows, scored as one batch.
+    vector<vector<size_t>> bootstrap_rows;          //< Bootstrap sample of every tree, drawn from train_rows.
+    vector<vector<size_t>> all_rows;                //< train_rows alone, the sample of every tree without bootstrap.
+    vector<unsigned int> tree_seeds;                //< Feature seed of every tree.
+  };
+
+  /// @brief Draws the samples and seeds of trees not drawn yet, up to @p num_trees per fold.
+  void prepare_samples(int num_trees){
+    LRP_PHASE("search.prepare_samples");
+    for (Fold& fold : folds_){
+      size_t first = fold.tree_seeds.size();
+      if ((size_t)num_trees <= first) continue;
+      vector<unsigned int> sample_seeds;
+      for (size_t i = first; i < (size_t)num_trees; i++){
+        sample_seeds.push_back(rng_());
+        fold.tree_seeds.push_back(rng_());
+      }
+      fold.bootstrap_rows.resize(num_trees);
+      ThreadPool::global().parallel_for(num_trees - first, [&](size_t i){
+        mt19937 sample_rng(sample_seeds[i]);
+        vector<size_t>& rows = fold.bootstrap_rows[first + i];
+        rows = RandomForest::createBootstrapIndices(fold.train_rows.size(), sample_rng);
+        for (size_t& row : rows) row = fold.train_rows[row];      //positions in the fold to rows of data_
+      });
+    }
+  }
+
+  const vector<vector<double>>& data_;
+  mt19937 rng_;
+  vector<Fold> folds_;
+  map<int, vector<unique_ptr<BinnedMatrix>>> binned_;       //< Quantized data_ by max_bins, one per fold, cut on its training rows.
+};
+
+#endif  //HYPERPARAMETERSEARCH_H
@@ -0,0 +1,214 @@
+//Metrics.h
+/**
+  *@file Metrics.h
+  *@brief Header file for the evaluation metrics of binary probability outputs: confusion matrices, ROC and PR AUC, log-loss, Brier score and calibration
+  *Contain both declaraction and implementation
+*/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "RandomForest.h"
+#include "../Includes/Instrumentation.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <utility>
+
+using namespace std;
+
+/**
+  *@brief Counts of a binary classification at one threshold.
+  */
+struct ConfusionMatrix {
+  double threshold = 0.5;               //< Decision threshold the counts were taken at.
+  size_t true_positives = 0;
+  size_t false_positives = 0;
+  size_t true_negatives = 0;
+  size_t false_negatives = 0;
+
+  size_t total() const { return true_positives + false_positives + true_negatives + false_negatives; }
+  double accuracy() const { return total() == 0 ? 0.0 : (true_positives + true_negatives) / (double)total(); }
+  /// @brief 1 when nothing is predicted positive, as there is no false positive.
+  double precision() const { return true_positives + false_positives == 0 ? 1.0 : true_positives / (double)(true_positives + false_positives); }
+  double recall() const { return true_positives + false_negatives == 0 ? 0.0 : true_positives / (double)(true_positives + false_negatives); }
+  double false_positive_rate() const { return false_positives + true_negatives == 0 ? 0.0 : false_positives / (double)(false_positives + true_negatives); }
+  double f1() const {
+    double p = precision(), r = recall();
+    return p + r == 0 ? 0.0 : 2 * p * r / (p + r);
+  }
+};
+
+/**
+  *@brief Rows whose probability fell in [lower, upper), the last bin also holding 1.
+  */
+struct CalibrationBin {
+  double lower = 0.0;
+  double upper = 0.0;
+  size_t count = 0;
+  double mean_probability = 0.0;        //< Average predicted probability in the bin.
+  double observed_rate = 0.0;           //< Share of the bin's rows labelled 1.
+};
+
+/**
+  *@brief Every metric of one set of binary predictions, built from a single sort of the probabilities.
+  */
+struct EvaluationReport {
+  size_t rows = 0;
+  size_t positives = 0;
+  ConfusionMatrix predicted;                    //< Confusion of the hard predictions.
+  vector<ConfusionMatrix> curve;                //< One entry per distinct probability, highest first; rows at or above the threshold are positive.
+  double roc_auc = 0.0;                         //< NaN when only one class is present.
+  double pr_auc = 0.0;                          //< Average precision, the step-wise area under the precision-recall curve. NaN without positives.
+  double log_loss = 0.0;                        //< Probabilities are clipped to [1e-15, 1 - 1e-15].
+  double brier = 0.0;
+  vector<CalibrationBin> calibration;           //< Equal-width bins over [0, 1].
+  double expected_calibration_error = 0.0;      //< Row-weighted mean gap between mean_probability and observed_rate.
+
+  /**
+    *@brief Confusion when rows with probability strictly above @p threshold are positive, looked up in the curve.
+    */
+  ConfusionMatrix at_threshold(double threshold) const {
+    //the curve is ordered by decreasing threshold; take the last entry still above it
+    auto above = partition_point(curve.begin(), curve.end(), [&](const ConfusionMatrix& point){ return point.threshold > threshold; });
+    ConfusionMatrix result;
+    if (above != curve.begin()) result = *(above - 1);
+    else {
+      result.true_negatives = rows - positives;
+      result.false_negatives = positives;
+    }
+    result.threshold = threshold;
+    return result;
+  }
+
+  /**
+    *@brief Writes the summary metrics and the calibration table as text.
+    */
+  void write(ostream& out) const {
+    out << "Rows " << rows << " (" << positives << " positive)\n"
+        << "Accuracy " << predicted.accuracy() << " (TP " << predicted.true_positives << ", TN " << predicted.true_negatives
+        << ", FP " << predicted.false_positives << ", FN " << predicted.false_negatives << ")\n"
+        << "Precision " << predicted.precision() << ", recall " << predicted.recall() << ", F1 " << predicted.f1() << "\n"
+        << "ROC AUC " << roc_auc << ", PR AUC " << pr_auc << ", log-loss " << log_loss << ", Brier " << brier
+        << ", ECE " << expected_calibration_error << "\n"
+        << "lower,upper,count,mean_probability,observed_rate\n";
+    for (const CalibrationBin& bin : calibration){
+      out << bin.lower << "," << bin.upper << "," << bin.count << "," << bin.mean_probability << "," << bin.observed_rate << "\n";
+    }
+  }
+};
+
+/**
+  *@brief Computes every metric of @p probabilities against 0/1 @p labels.
+  *
+*The rows are sorted once by decreasing probability; one walk over that order yields the confusion matrix at every
+*distinct threshold, and the ROC and PR areas from those counts. Log-loss, Brier score and calibration need no order and
+*are summed in the same walk.
+*@param threshold Rows with probability strictly above it are predicted positive in EvaluationReport::predicted.
+*@param calibration_bins Number of equal-width calibration bins, at least 1.
+*/
+inline EvaluationReport evaluate_probabilities(const vector<double>& probabilities, const vector<int>& labels, double threshold = 0.5, size_t calibration_bins = 10){
+  LRP_PHASE("metrics.evaluate");
+  if (probabilities.size() != labels.size()) throw invalid_argument("evaluate_probabilities needs one label per probability.");
+  if (calibration_bins == 0) throw invalid_argument("evaluate_probabilities needs at least one calibration bin.");
+  const double epsilon = 1e-15;
+  const size_t n = probabilities.size();
+  EvaluationReport report;
+  report.rows = n;
+
+  vector<pair<double, int>> order(n);
+  vector<double> bin_probability(calibration_bins, 0.0);
+  vector<size_t> bin_count(calibration_bins, 0), bin_positives(calibration_bins, 0);
+  double log_loss = 0.0, squared_error = 0.0;
+  for (size_t i = 0; i < n; i++){
+    int label = labels[i];
+    if (label != 0 && label != 1) throw invalid_argument("evaluate_probabilities needs labels 0 or 1.");
+    double p = probabilities[i];
+    order[i] = {p, label};
+    report.positives += label;
+    double clipped = min(max(p, epsilon), 1.0 - epsilon);
+    log_loss -= label == 1 ? log(clipped) : log(1.0 - clipped);
+    squared_error += (p - label) * (p - label);
+    size_t bin = min(static_cast<size_t>(max(p, 0.0) * calibration_bins), calibration_bins - 1);
+    bin_probability[bin] += p;
+    bin_count[bin]++;
+    bin_positives[bin] += label;
+  }
+  const size_t negatives = n - report.positives;
+  if (n > 0){
+    report.log_loss = log_loss / n;
+    report.brier = squared_error / n;
+  }
+
+  report.calibration.resize(calibration_bins);
+  for (size_t b = 0; b < calibration_bins; b++){
+    CalibrationBin& bin = report.calibration[b];
+    bin.lower = b / (double)calibration_bins;
+    bin.upper = (b + 1) / (double)calibration_bins;
+    bin.count = bin_count[b];
+    if (bin.count == 0) continue;
+    bin.mean_probability = bin_probability[b] / bin.count;
+    bin.observed_rate = bin_positives[b] / (double)bin.count;
+    report.expected_calibration_error += bin.count / (double)n * fabs(bin.mean_probability - bin.observed_rate);
+  }
+
+  sort(order.begin(), order.end(), [](const pair<double, int>& a, const pair<double, int>& b){ return a.first > b.first; });
+  size_t true_positives = 0, false_positives = 0;
+  double roc_area = 0.0, average_precision = 0.0;
+  double previous_tpr = 0.0, previous_fpr = 0.0, previous_recall = 0.0;
+  for (size_t i = 0; i < n; i++){
+    if (order[i].second == 1) true_positives++;
+    else false_positives++;
+    //tied probabilities share one threshold, so emit a point only at the end of each run
+    if (i + 1 < n && order[i + 1].first == order[i].first) continue;
+    ConfusionMatrix point;
+    point.threshold = order[i].first;
+    point.true_positives = true_positives;
+    point.false_positives = false_positives;
+    point.true_negatives = negatives - false_positives;
+    point.false_negatives = report.positives - true_positives;
+    double tpr = point.recall(), fpr = point.false_positive_rate();
+    roc_area += (fpr - previous_fpr) * (tpr + previous_tpr) / 2;
+    average_precision += (tpr - previous_recall) * point.precision();
+    previous_tpr = previous_recall = tpr;
+    previous_fpr = fpr;
+    report.curve.push_back(point);
+  }
+  report.roc_auc = report.positives == 0 || negatives == 0 ? numeric_limits<double>::quiet_NaN() : roc_area;
+  report.pr_auc = report.positives == 0 ? numeric_limits<double>::quiet_NaN() : average_precision;
+  report.predicted = report.at_threshold(threshold);
+  return report;
+}
+
+/**
+  *@brief Evaluates @p forest on labelled @p rows with one batch scoring pass on the shared pool.
+  *
+*The ranking, log-loss, Brier and calibration metrics use the @p mode probability; EvaluationReport::predicted counts the
+*majority vote, so it matches RandomForest::predict and evaluate_accuracy.
+*@param rows Rows with the 0/1 label last.
+*@param num_threads Threads scoring rows, 0 for the whole shared pool.
+*/
+inline EvaluationReport evaluate_forest(const RandomForest& forest, const vector<vector<double>>& rows, RandomForest::ProbabilityMode mode = RandomForest::LeafFrequency, size_t calibration_bins = 10, size_t num_threads = 0){
+  vector<RandomForest::ForestScore> scores;
+  forest.score_batch(rows, scores, num_threads);
+  vector<double> probabilities(rows.size());
+  vector<int> labels(rows.size());
+  for (size_t i = 0; i < rows.size(); i++){
+    probabilities[i] = scores[i].probability(mode);
+    labels[i] = static_cast<int>(rows[i].back());
+  }
+  EvaluationReport report = evaluate_probabilities(probabilities, labels, 0.5, calibration_bins);
+  ConfusionMatrix& votes = report.predicted;
+  votes = ConfusionMatrix();
+  for (size_t i = 0; i < rows.size(); i++){
+    bool positive = scores[i].prediction() == 1;
+    if (labels[i] == 1) (positive ? votes.true_positives : votes.false_negatives)++;
+    else (positive ? votes.false_positives : votes.true_negatives)++;
+  }
+  return report;
+}
+
+#endif  //METRICS_H
@@ -12,6 +12,19 @@
 
 using namespace std;
 
+class Node;
+
+/**
+ * @brief Deleter of a node's child pointers. Nodes that live in a NodeArena are not freed one by one:
+ * the arena releases all of them at once, so they are skipped here.
+*/
+struct NodeDeleter {
+    void operator()(Node* node) const;
+};
+
+/// @brief Owning pointer to a node.
+typedef unique_ptr<Node, NodeDeleter> NodePtr;
+
 /**
  * @class Node
  * @brief Node class for decision tree nodes.
@@ -20,13 +33,13 @@ using namespace std;
 
 class Node{
 public:
-    Node() : left(nullptr), right(nullptr), feature_index(-1), threshold(0.0), is_leaf(false), label(-1), gini_index(0.0){}
+    Node() : left(nullptr), right(nullptr), feature_index(-1), threshold(0.0), is_leaf(false), in_arena(false), label(-1), gini_index(0.0), value(0.0){}
 
     /// @brief Pointer to the left child node
-    unique_ptr<Node> left;
+    NodePtr left;
 
     /// @brief Pointer to the right child node
-    unique_ptr<Node> right;
+    NodePtr right;
 
     /// @brief Index of the feature based on which the node splits
     int feature_index;
@@ -37,11 +50,21 @@ public:
     /// @brief Flag to check if the node is a leaf node
     bool is_leaf;
 
+    /// @brief Set for nodes allocated from a NodeArena, which owns their memory
+    bool in_arena;
+
     /// @brief class label assigned to a leaf node
     int label;
 
     /// @brief Gini index for the node, used in splitting criteria
     double gini_index;
+
+    /// @brief Real-valued output of a leaf node, such as the raw score of a regression (boosting) leaf
+    double value;
 };
 
+inline void NodeDeleter::operator()(Node* node) const {
+    if (!node->in_arena) delete node;
+}
+
 #endif      //NODE_H
\ No newline at end of file
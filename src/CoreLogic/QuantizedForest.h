@@ -0,0 +1,210 @@
+//QuantizedForest.h
+/**
+  *@file QuantizedForest.h
+  *@brief Header file for the ThresholdTable and QuantizedForest classes, forest inference on packed nodes with integer thresholds.
+  *Contain both declaraction and implementation
+*/
+
+#ifndef QUANTIZEDFOREST_H
+#define QUANTIZEDFOREST_H
+
+#include "DecisionTree.h"
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+
+using namespace std;
+
+/**
+  *@class ThresholdTable
+  *@brief Sorted distinct split thresholds of every feature, shared by all trees of a forest.
+  *
+*A value x is quantized to bin(x) = number of thresholds <= x. For the k-th threshold t_k of the feature,
+*x < t_k holds exactly when bin(x) <= k, so the integer test takes the same branch as the double one for every input,
+*not just the training values. NaN sorts after every threshold and goes right, as in DecisionTree::find_leaf.
+*/
+
+class ThresholdTable {
+public:
+  ThresholdTable() {}
+
+  explicit ThresholdTable(const vector<DecisionTree>& trees){
+    for (const auto& tree : trees){
+      vector<const Node*> stack = {tree.get_root()};
+      while (!stack.empty()){
+        const Node* node = stack.back();
+        stack.pop_back();
+        if (node->is_leaf) continue;
+        if (thresholds_.size() <= static_cast<size_t>(node->feature_index)) thresholds_.resize(node->feature_index + 1);
+        thresholds_[node->feature_index].push_back(node->threshold);
+        stack.push_back(node->left.get());
+        stack.push_back(node->right.get());
+      }
+    }
+    for (auto& values : thresholds_){
+      sort(values.begin(), values.end());
+      values.erase(unique(values.begin(), values.end()), values.end());
+    }
+  }
+
+  size_t num_features() const { return thresholds_.size(); }
+
+  /// @brief Largest number of thresholds on any feature; bins run from 0 to this value.
+  size_t max_thresholds() const {
+    size_t largest = 0;
+    for (const auto& values : thresholds_) largest = max(largest, values.size());
+    return largest;
+  }
+
+  /// @brief Index of @p threshold among the thresholds of @p feature.
+  size_t index_of(size_t feature, double threshold) const {
+    const vector<double>& values = thresholds_[feature];
+    return lower_bound(values.begin(), values.end(), threshold) - values.begin();
+  }
+
+  /// @brief Bin of value @p x for feature @p feature.
+  size_t bin_of(size_t feature, double x) const {
+    const vector<double>& values = thresholds_[feature];
+    return upper_bound(values.begin(), values.end(), x) - values.begin();
+  }
+
+  /// @brief Quantizes the first num_features() values of a row.
+  template <typename Bin>
+  void quantize(const double* row, Bin* bins) const {
+    for (size_t f = 0; f < thresholds_.size(); f++) bins[f] = static_cast<Bin>(bin_of(f, row[f]));
+  }
+
+private:
+  vector<vector<double>> thresholds_;
+};
+
+/**
+  *@brief 8-byte split or leaf node of a frozen tree, with a uint8 or uint16 threshold index.
+  *
+*Node spends 56 bytes on two unique_ptrs, a double threshold, the training gini and a leaf label that is never meaningful
+*at the same time as the split fields. Here a split keeps only its feature and threshold index, and a leaf is marked by a
+*negative child: -(leaf index + 1) into the leaf side table. Eight nodes share a cache line.
+*/
+template <typename Bin>
+struct BasicPackedNode {
+  uint16_t feature;               //< Split feature, 0 for a leaf.
+  Bin bin;                        //< Index of the split threshold in the ThresholdTable, 0 for a leaf.
+  int32_t child;                  //< Left child (the right child follows it), or -(leaf index + 1).
+};
+
+typedef BasicPackedNode<uint16_t> PackedNode;
+typedef BasicPackedNode<uint8_t> NarrowPackedNode;      //< Used when no feature has more than 255 thresholds.
+
+static_assert(sizeof(PackedNode) == 8 && sizeof(NarrowPackedNode) == 8, "Packed nodes must stay 8 bytes");
+
+/**
+  *@class QuantizedForest
+  *@brief Frozen forest of packed nodes, whose split nodes hold a threshold index instead of a double.
+  *
+*Thresholds are stored as uint8 bin indexes when no feature has more than 255 distinct thresholds and as uint16 otherwise,
+*so rows are quantized to one byte per feature in the common case. The padding keeps both node forms at 8 bytes.
+*Each row is quantized once against the shared ThresholdTable and then walked through every tree with integer compares.
+*Leaf labels and values live in a side table, as does the training gini of every node, so the walk only touches the packed nodes.
+*Leaf values are summed in tree order, so results are bit-identical to RandomForest::score.
+*/
+
+class QuantizedForest {
+public:
+  QuantizedForest() : wide_(false) {}
+
+  /**
+    *@throws invalid_argument if a feature has more than 65535 distinct thresholds or the forest has more than 65536 features.
+    */
+  explicit QuantizedForest(const vector<DecisionTree>& trees) : table_(trees) {
+    if (table_.max_thresholds() > numeric_limits<uint16_t>::max()) throw invalid_argument("Too many distinct thresholds on one feature to quantize.");
+    if (table_.num_features() > static_cast<size_t>(numeric_limits<uint16_t>::max()) + 1) throw invalid_argument("Too many features to quantize.");
+    wide_ = table_.max_thresholds() > numeric_limits<uint8_t>::max();
+    for (const auto& tree : trees){
+      if (wide_) add_tree(tree.get_root(), nodes16_);
+      else add_tree(tree.get_root(), nodes8_);
+    }
+  }
+
+  size_t num_trees() const { return roots_.size(); }
+
+  /// @brief Whether thresholds are stored as uint16 rather than uint8.
+  bool wide_bins() const { return wide_; }
+
+  const ThresholdTable& get_threshold_table() const { return table_; }
+
+  size_t num_nodes() const { return wide_ ? nodes16_.size() : nodes8_.size(); }
+
+  /// @brief Gini index recorded for node @p node during training (side table, not read when scoring).
+  double node_gini(size_t node) const { return gini_[node]; }
+
+  /// @brief Bytes used by the packed nodes and the leaf table, the data scoring reads.
+  size_t memory_bytes() const {
+    return nodes8_.size() * sizeof(NarrowPackedNode) + nodes16_.size() * sizeof(PackedNode)
+         + leaf_label_.size() * sizeof(int) + leaf_value_.size() * sizeof(double);
+  }
+
+  /**
+    *@brief Votes for label 1 and summed leaf values of one row over every tree, in tree order.
+    *@param feature Vector of features. Extra trailing values (such as the label) are ignored.
+    */
+  void score(const vector<double>& feature, int& positive_votes, double& value_sum) const {
+    if (wide_) score_bins<uint16_t>(feature.data(), nodes16_, positive_votes, value_sum);
+    else score_bins<uint8_t>(feature.data(), nodes8_, positive_votes, value_sum);
+  }
+
+private:
+  template <typename Bin>
+  void score_bins(const double* row, const vector<BasicPackedNode<Bin>>& nodes, int& positive_votes, double& value_sum) const {
+    static thread_local vector<Bin> bins;
+    bins.resize(table_.num_features());
+    table_.quantize(row, bins.data());
+    positive_votes = 0;
+    value_sum = 0.0;
+    for (int32_t root : roots_){
+      const BasicPackedNode<Bin>* node = &nodes[root];
+      while (node->child >= 0){
+        node = &nodes[node->child + (bins[node->feature] > node->bin)];
+      }
+      size_t leaf = -(node->child + 1);
+      if (leaf_label_[leaf] == 1) positive_votes++;
+      value_sum += leaf_value_[leaf];
+    }
+  }
+
+  template <typename Bin>
+  void add_tree(const Node* root, vector<BasicPackedNode<Bin>>& nodes){
+    vector<const Node*> queue = {root};
+    size_t base = nodes.size();
+    roots_.push_back(static_cast<int32_t>(base));
+    for (size_t i = 0; i < queue.size(); i++){
+      const Node* node = queue[i];
+      BasicPackedNode<Bin> packed = {0, 0, 0};
+      if (node->is_leaf){
+        packed.child = -static_cast<int32_t>(leaf_label_.size()) - 1;
+        leaf_label_.push_back(node->label);
+        leaf_value_.push_back(node->value);
+      } else {
+        packed.feature = static_cast<uint16_t>(node->feature_index);
+        packed.bin = static_cast<Bin>(table_.index_of(node->feature_index, node->threshold));
+        packed.child = static_cast<int32_t>(base + queue.size());
+        queue.push_back(node->left.get());
+        queue.push_back(node->right.get());
+      }
+      nodes.push_back(packed);
+      gini_.push_back(node->gini_index);
+    }
+  }
+
+  ThresholdTable table_;
+  bool wide_;
+  vector<int32_t> roots_;                   //< Root node of every tree.
+  vector<NarrowPackedNode> nodes8_;         //< Nodes of every tree, breadth first, when thresholds fit in uint8.
+  vector<PackedNode> nodes16_;              //< Nodes of every tree otherwise.
+  vector<int> leaf_label_;                  //< Leaf side table.
+  vector<double> leaf_value_;
+  vector<double> gini_;                     //< Training-only side table: gini index of every node, in node order.
+};
+
+#endif  //QUANTIZEDFOREST_H
@@ -0,0 +1,166 @@
+//QuickScorer.h
+/**
+  *@file QuickScorer.h
+  *@brief Header file for the QuickScorer class, a bitvector based forest inference engine.
+  *Contain both declaraction and implementation
+*/
+
+#ifndef QUICKSCORER_H
+#define QUICKSCORER_H
+
+#include "DecisionTree.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
+using namespace std;
+
+/**
+  *@class QuickScorer
+  *@brief Scores a trained forest with the QuickScorer algorithm instead of walking each tree.
+  *
+*The leaves of every tree are numbered left to right and a tree's state is a bitvector with one bit per leaf.
+*Every split node stores a mask that clears the leaves of its left subtree, which become unreachable when the row goes right
+*(feature >= threshold). Nodes are grouped by feature and sorted by threshold, so scoring a row is, per feature, a sequential
+*scan that ANDs masks until the first threshold above the value. The exit leaf of a tree is the lowest bit still set.
+*The exit leaves are exactly those DecisionTree::predict reaches, so the labels and leaf values are bit-identical.
+*A row visits about half of all split nodes, so the engine pays off for shallow trees (up to a few hundred leaves);
+*fully grown trees are faster with FlatForest or QuantizedForest.
+*/
+
+class QuickScorer {
+public:
+  QuickScorer() : num_features_(0) {}
+
+  /**
+    *@brief Builds the feature-ordered node tables and leaf masks of a forest.
+    *@param trees Trained trees; they are not referenced after construction.
+    *@throws invalid_argument if the masks or bitvectors need more than 2^32 words, the range of their 32-bit offsets.
+    */
+  explicit QuickScorer(const vector<DecisionTree>& trees) : num_features_(0) {
+    vector<vector<FeatureNode>> by_feature;
+    for (size_t t = 0; t < trees.size(); t++){
+      add_tree(trees[t].get_root(), static_cast<uint32_t>(t), by_feature);
+    }
+    num_features_ = by_feature.size();
+    feature_offset_.assign(1, 0);
+    for (auto& nodes : by_feature){
+      stable_sort(nodes.begin(), nodes.end(), [](const FeatureNode& a, const FeatureNode& b){ return a.threshold < b.threshold; });
+      nodes_.insert(nodes_.end(), nodes.begin(), nodes.end());
+      feature_offset_.push_back(nodes_.size());
+    }
+  }
+
+  size_t num_trees() const { return tree_words_.size(); }
+
+  /**
+    *@brief Calls fn(label, value) with the exit leaf of every tree, in tree order.
+    *@param feature Vector of features. Extra trailing values (such as the label) are ignored.
+    */
+  template <typename Visitor>
+  void for_each_exit_leaf(const vector<double>& feature, Visitor&& fn) const {
+    static thread_local vector<uint64_t> state;
+    state.assign(total_words_, ~0ULL);
+    for (size_t f = 0; f < num_features_; f++){
+      double x = feature[f];
+      size_t i = feature_offset_[f], end = feature_offset_[f + 1];
+      //NaN fails every "x < threshold" test, so it goes right at every node of this feature
+      bool all_right = std::isnan(x);
+      for (; i < end && (all_right || nodes_[i].threshold <= x); i++){
+        const FeatureNode& node = nodes_[i];
+        uint64_t* words = &state[tree_word_offset_[node.tree] + node.first_word];
+        const uint64_t* mask = &masks_[node.mask_offset];
+        for (uint32_t w = 0; w < node.num_words; w++) words[w] &= mask[w];
+      }
+    }
+    for (size_t t = 0; t < tree_words_.size(); t++){
+      const uint64_t* words = &state[tree_word_offset_[t]];
+      uint32_t w = 0;
+      while (words[w] == 0) w++;                      //the exit leaf always survives
+      size_t leaf = tree_leaf_offset_[t] + w * 64 + __builtin_ctzll(words[w]);
+      fn(leaf_label_[leaf], leaf_value_[leaf]);
+    }
+  }
+
+private:
+  struct FeatureNode {
+    double threshold;
+    uint32_t tree;
+    uint32_t mask_offset;           //< Index of the node's first mask word in masks_.
+    uint32_t first_word;            //< First bitvector word of the tree the mask covers.
+    uint32_t num_words;             //< Mask words; the left subtree's leaves are contiguous, so only the words they span are stored.
+  };
+
+  void add_tree(const Node* root, uint32_t tree, vector<vector<FeatureNode>>& by_feature){
+    //preorder visits leaves left to right; count leaves below every node with a reverse pass
+    vector<const Node*> preorder;
+    vector<const Node*> stack = {root};
+    while (!stack.empty()){
+      const Node* node = stack.back();
+      stack.pop_back();
+      preorder.push_back(node);
+      if (!node->is_leaf){
+        stack.push_back(node->right.get());
+        stack.push_back(node->left.get());
+      }
+    }
+    unordered_map<const Node*, size_t> leaf_count, first_leaf;
+    for (auto it = preorder.rbegin(); it != preorder.rend(); ++it){
+      const Node* node = *it;
+      leaf_count[node] = node->is_leaf ? 1 : leaf_count[node->left.get()] + leaf_count[node->right.get()];
+    }
+    size_t num_leaves = leaf_count[root];
+    uint32_t words = static_cast<uint32_t>((num_leaves + 63) / 64);
+    if (total_words_ + words > numeric_limits<uint32_t>::max()) throw invalid_argument("Forest too large for QuickScorer: tree bitvectors exceed 2^32 words.");
+    tree_word_offset_.push_back(total_words_);
+    tree_words_.push_back(words);
+    tree_leaf_offset_.push_back(leaf_label_.size());
+    total_words_ += words;
+    for (size_t i = 0; i < num_leaves; i++){
+      leaf_label_.push_back(0);
+      leaf_value_.push_back(0.0);
+    }
+
+    first_leaf[root] = 0;
+    for (const Node* node : preorder){
+      size_t first = first_leaf[node];
+      if (node->is_leaf){
+        leaf_label_[tree_leaf_offset_.back() + first] = node->label;
+        leaf_value_[tree_leaf_offset_.back() + first] = node->value;
+        continue;
+      }
+      size_t left_leaves = leaf_count[node->left.get()];
+      first_leaf[node->left.get()] = first;
+      first_leaf[node->right.get()] = first + left_leaves;
+
+      //clear the bits of the left subtree's leaves
+      uint32_t first_word = static_cast<uint32_t>(first / 64);
+      uint32_t num_words = static_cast<uint32_t>((first + left_leaves - 1) / 64 - first_word + 1);
+      if (masks_.size() + num_words > numeric_limits<uint32_t>::max()) throw invalid_argument("Forest too large for QuickScorer: leaf masks exceed 2^32 words.");
+      uint32_t mask_offset = static_cast<uint32_t>(masks_.size());
+      masks_.resize(masks_.size() + num_words, ~0ULL);
+      for (size_t leaf = first; leaf < first + left_leaves; leaf++){
+        masks_[mask_offset + leaf / 64 - first_word] &= ~(1ULL << (leaf % 64));
+      }
+      if (by_feature.size() <= static_cast<size_t>(node->feature_index)) by_feature.resize(node->feature_index + 1);
+      by_feature[node->feature_index].push_back({node->threshold, tree, mask_offset, first_word, num_words});
+    }
+  }
+
+  size_t num_features_;
+  vector<FeatureNode> nodes_;               //< Split nodes of all trees, grouped by feature and sorted by threshold.
+  vector<size_t> feature_offset_;           //< nodes_[feature_offset_[f], feature_offset_[f + 1]) belong to feature f.
+  vector<uint64_t> masks_;                  //< Leaf masks, num_words per node.
+  vector<uint32_t> tree_word_offset_;       //< First bitvector word of every tree.
+  vector<uint32_t> tree_words_;             //< Bitvector words of every tree.
+  vector<size_t> tree_leaf_offset_;         //< First leaf of every tree in leaf_label_ / leaf_value_.
+  vector<int> leaf_label_;
+  vector<double> leaf_value_;
+  size_t total_words_ = 0;
+};
+
+#endif  //QUICKSCORER_H
@@ -2,12 +2,20 @@
 #define RANDOMFOREST_H
 
 #include "DecisionTree.h"
+#include "QuickScorer.h"
+#include "FlatForest.h"
+#include "QuantizedForest.h"
 #include <vector>
 #include <cstdlib>
 #include <iostream>
 #include <algorithm>
+#include <cmath>
 #include <numeric>
 #include <random>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <sstream>
 #include <unordered_set>
 
 using namespace std;
@@ -27,28 +35,100 @@ public:
   /**
     *@brief Constructor that initializes the forest with a specified number of trees.
     *@param num_trees Number of trees to include in the forest.
+    *@param tree_options Pre-pruning limits and per-split feature subsampling applied to every tree.
     */
-  RandomForest(int num_trees): num_trees_(num_trees), trees_(num_trees), rng(random_device{}()){}          //Constructor initializes the forest with a specified number of trees
+  RandomForest(int num_trees, const TreeOptions& tree_options = default_tree_options()): num_trees_(num_trees), tree_options_(tree_options), rng(random_device{}()){          //Constructor initializes the forest with a specified number of trees
+    trees_.reserve(num_trees);
+    for (int i = 0; i < num_trees; i++){
+      trees_.emplace_back(tree_options);
+    }
+  }
+  /**
+    *@brief Seeds the forest's RNG. The holdout split, bootstrap samples, tree seeds and cross-validation folds all derive from it,
+    *so two forests trained with the same seed, options and data are bit-identical, whatever the thread count.
+    *Without a seed the RNG is seeded from random_device.
+    */
+  void set_seed(unsigned int seed){ rng.seed(seed); }
+
+  /**
+    *@brief Sets the share of the rows train holds out from every tree (0.2 by default), 0 to train on all of them.
+    */
+  void set_holdout_fraction(double fraction){ holdout_fraction_ = fraction; }
+
+  /**
+    *@brief Sets whether every tree is trained on a bootstrap sample (the default) or on the whole training split.
+    */
+  void set_bootstrap(bool bootstrap){ bootstrap_ = bootstrap; }
+
+  /**
+    *@brief Tree options used when none are given: fully grown trees drawing sqrt(F) features per split.
+    */
+  static TreeOptions default_tree_options(){
+    TreeOptions options;
+    options.max_features.kind = MaxFeatures::Sqrt;
+    return options;
+  }
+
   /**
     *@brief Trains the random forest using the provided dataset.
     *@param data_vec Data used for training the random forest. Each tree is train on a bootstrap sample of this data.
     */
   void train (const vector<vector<double>>& data_vec){
-    cout<<"Starting training process..." << endl;
+    LRP_PHASE("forest.train");
     vector<vector<double>> train_data, test_data;
-    splitData(data_vec, train_data, test_data, 0.2);
-    cout<< "Data split into " << train_data.size() <<" training sample and " << test_data.size() <<" test samples." << endl;
-
-    cout <<"Training "<<num_trees_ << " trees with bagging..." << endl;
-    uniform_int_distribution<> dist(0, data_vec.size() - 1);
-    mt19937 rng(random_device{}());
+    splitData(data_vec, train_data, test_data, holdout_fraction_, rng);
+    num_features_ = data_vec.empty() ? 0 : data_vec[0].size() - 1;
+    LRP_LOG_INFO("forest.train", "Training " << num_trees_ << " trees on " << train_data.size() << " rows (" << test_data.size() << " held out)");
+    tree_order_.clear();
 
+    //every tree's sample and seed are drawn up front, so the trees can be trained in any order on any number of threads
+    vector<unsigned int> sample_seeds(num_trees_), tree_seeds(num_trees_);
     for (int i = 0; i < num_trees_; i++){
-      cout<<"Training Decision Tree " << (i + 1) << " with all feature using bootstrap samples..." << endl;
-      vector<vector<double>> bootstrap_sample = createBootstrapSample(train_data);
-      cout << "Bootstrap sample size: " << bootstrap_sample.size() << endl;
-      trees_[i].train(bootstrap_sample);
+      sample_seeds[i] = rng();
+      tree_seeds[i] = rng();
+    }
+    //samples are row indexes into train_data, drawn inside each task so only the trees in flight hold one
+    vector<size_t> all_rows(bootstrap_ ? 0 : train_data.size());
+    iota(all_rows.begin(), all_rows.end(), 0);
+    unique_ptr<BinnedMatrix> binned = bin_data(train_data);
+    ThreadPool::global().parallel_for(num_trees_, [&](size_t i){
+      vector<size_t> bootstrap_rows;
+      if (bootstrap_){
+        LRP_PHASE("forest.train/bootstrap");
+        mt19937 sample_rng(sample_seeds[i]);
+        bootstrap_rows = createBootstrapIndices(train_data.size(), sample_rng);
+      }
+      train_tree(i, train_data, bootstrap_ ? bootstrap_rows : all_rows, tree_seeds[i], binned.get());
+    }, tree_options_.num_threads);
+  LRP_PHASE("forest.train/build_backend");
+  set_inference_backend(backend_);
+}
+
+/**
+  *@brief Trains tree i on the rows of @p data listed in samples[i] with seed tree_seeds[i], with no holdout split and no sampling of its own.
+  *
+*Lets callers that train many forests on the same data, such as HyperparameterSearch, draw the samples once and share them.
+*@param samples One row list per tree, or a single list every tree uses. Entries past num_trees are ignored.
+*@param tree_seeds Seed of every tree's feature draws, at least num_trees of them.
+*@param binned @p data quantized for histogram splits (see TreeOptions::max_bins), shared by the trees. Null bins it here if max_bins is set.
+*/
+void train_on_samples(const vector<vector<double>>& data, const vector<vector<size_t>>& samples, const vector<unsigned int>& tree_seeds, const BinnedMatrix* binned = nullptr){
+  LRP_PHASE("forest.train");
+  if (samples.empty() || (samples.size() > 1 && samples.size() < (size_t)num_trees_) || tree_seeds.size() < (size_t)num_trees_){
+    throw invalid_argument("train_on_samples needs one sample and one seed per tree.");
+  }
+  tree_order_.clear();
+  num_features_ = data.empty() ? 0 : data[0].size() - 1;
+  unique_ptr<BinnedMatrix> own_binned;
+  if (!binned){
+    own_binned = bin_data(data);
+    binned = own_binned.get();
   }
+  ThreadPool::global().parallel_for(num_trees_, [&](size_t i){
+    train_tree(i, data, samples[samples.size() == 1 ? 0 : i], tree_seeds[i], binned);
+  }, tree_options_.num_threads);
+  LRP_PHASE("forest.train/build_backend");
+  set_inference_backend(backend_);
 }
 /**
   *@brief Predict the class label for the given feature using majority voting among all trees.
@@ -57,10 +137,22 @@ public:
   */
 
 int predict(const vector<double>& feature){
+  require_features(feature.size());
   map<int, int> vote_count;
-  for (auto& tree : trees_){
-    int prediction = tree.predict(feature);
-    vote_count[prediction]++;
+  if (quick_scorer_){
+    quick_scorer_->for_each_exit_leaf(feature, [&](int label, double){ vote_count[label]++; });
+  } else if (flat_forest_ || quantized_forest_){
+    int positive_votes;
+    double value_sum;
+    if (flat_forest_) flat_forest_->score(feature, positive_votes, value_sum);
+    else quantized_forest_->score(feature, positive_votes, value_sum);
+    vote_count[1] = positive_votes;
+    vote_count[0] = static_cast<int>(trees_.size()) - positive_votes;
+  } else {
+    for (auto& tree : trees_){
+      int prediction = tree.predict(feature);
+      vote_count[prediction]++;
+    }
   }
   
   int majorityVote = -1;
@@ -74,6 +166,246 @@ int predict(const vector<double>& feature){
   return majorityVote;
 }
 
+/**
+ * @brief How predict_proba turns the trees' outputs into a probability of label 1.
+*/
+enum ProbabilityMode {
+  VoteFraction,         //< Share of trees whose leaf predicts label 1.
+  LeafFrequency         //< Share of training rows labelled 1 in each reached leaf, averaged across trees.
+};
+
+/**
+ * @brief Both probability outputs for one row, computed in the same single pass over the trees.
+*/
+struct ForestScore {
+  double vote_fraction = 0.0;     //< Share of trees voting for label 1.
+  double leaf_frequency = 0.0;    //< Leaf frequency of label 1 averaged across trees.
+
+  /// @brief Distance of the vote from a tie, from 0 (split vote) to 1 (unanimous).
+  double vote_margin() const { return fabs(2.0 * vote_fraction - 1.0); }
+
+  double probability(ProbabilityMode mode) const { return mode == VoteFraction ? vote_fraction : leaf_frequency; }
+
+  /// @brief Majority-vote label, the one predict returns for 0/1 labels: ties go to 0.
+  int prediction() const { return vote_fraction > 0.5 ? 1 : 0; }
+};
+
+/**
+ * @brief Scores one row with a single pass over the trees. Labels are assumed to be 0/1. Does not allocate.
+*/
+ForestScore score(const vector<double>& feature) const {
+  ForestScore result;
+  if (trees_.empty()) return result;
+  require_features(feature.size());
+  int positive_votes = 0;
+  double frequency_sum = 0.0;
+  if (quick_scorer_){
+    quick_scorer_->for_each_exit_leaf(feature, [&](int label, double value){
+      if (label == 1) positive_votes++;
+      frequency_sum += value;
+    });
+  } else if (flat_forest_){
+    flat_forest_->score(feature, positive_votes, frequency_sum);
+  } else if (quantized_forest_){
+    quantized_forest_->score(feature, positive_votes, frequency_sum);
+  } else {
+    for (const auto& tree : trees_){
+      const Node* leaf = tree.find_leaf(feature);
+      if (leaf->label == 1) positive_votes++;
+      frequency_sum += leaf->value;
+    }
+  }
+  result.vote_fraction = positive_votes / (double)trees_.size();
+  result.leaf_frequency = frequency_sum / trees_.size();
+  return result;
+}
+
+/**
+ * @brief Probability of label 1 for the given features.
+ * @param feature Vector of features. Extra trailing values (such as the label) are ignored.
+ * @param mode Vote fractions or averaged leaf class frequencies.
+*/
+double predict_proba(const vector<double>& feature, ProbabilityMode mode = LeafFrequency) const {
+  return score(feature).probability(mode);
+}
+
+/**
+ * @brief Scores many rows on the shared pool. @p out is resized to rows.size() and reused across calls, so nothing is allocated per row.
+*/
+void score_batch(const vector<vector<double>>& rows, vector<ForestScore>& out, size_t num_threads = 0) const {
+  LRP_PHASE("forest.score_batch");
+  LRP_COUNT(RowsScored, rows.size());
+  require_rows(rows);
+  out.resize(rows.size());
+  if (flat_forest_){
+    score_blocks(rows, num_threads, [&](size_t i, const ForestScore& result){ out[i] = result; });
+    return;
+  }
+  ThreadPool::global().parallel_for(rows.size(), [&](size_t i){
+    out[i] = score(rows[i]);
+  }, num_threads);
+}
+
+/**
+ * @brief score_batch with feature @p feature of row i read from column[i], leaving @p rows untouched (permutation importance).
+ *
+ * The flat backend substitutes the value while copying each block of rows, which it does anyway; other backends copy one row at a time.
+*/
+void score_batch_with_column(const vector<vector<double>>& rows, size_t feature, const vector<double>& column, vector<ForestScore>& out, size_t num_threads = 0) const {
+  if (column.size() != rows.size()) throw invalid_argument("score_batch_with_column needs one column value per row.");
+  require_rows(rows);
+  out.resize(rows.size());
+  if (flat_forest_){
+    score_blocks(rows, num_threads, [&](size_t i, const ForestScore& result){ out[i] = result; }, feature, column.data());
+    return;
+  }
+  ThreadPool::global().parallel_for(rows.size(), [&](size_t i){
+    static thread_local vector<double> row;   //one scratch row per thread, refilled in place instead of allocated per row
+    row.assign(rows[i].begin(), rows[i].end());
+    row[feature] = column[i];
+    out[i] = score(row);
+  }, num_threads);
+}
+
+/**
+ * @brief Mean decrease in impurity of every feature, averaged over the trees and summing to 1.
+ *
+ * Every tree accumulates the weighted gini decrease of its splits while it is grown, so this costs nothing at training time.
+ * @return Empty for a forest read by load, which keeps only the tree structure.
+*/
+vector<double> impurity_importance() const {
+  vector<double> total;
+  for (const auto& tree : trees_){
+    const vector<double>& importance = tree.get_impurity_importance();
+    double sum = accumulate(importance.begin(), importance.end(), 0.0);
+    if (total.size() < importance.size()) total.resize(importance.size(), 0.0);
+    if (sum <= 0) continue;                 //a single-leaf tree has no splits to credit
+    for (size_t f = 0; f < importance.size(); f++) total[f] += importance[f] / sum;
+  }
+  double sum = accumulate(total.begin(), total.end(), 0.0);
+  if (sum > 0) for (double& value : total) value /= sum;
+  return total;
+}
+
+/**
+ * @brief Batch version of predict_proba. @p out is resized to rows.size().
+*/
+void predict_proba_batch(const vector<vector<double>>& rows, vector<double>& out, ProbabilityMode mode = LeafFrequency, size_t num_threads = 0) const {
+  LRP_PHASE("forest.predict_proba_batch");
+  LRP_COUNT(RowsScored, rows.size());
+  require_rows(rows);
+  out.resize(rows.size());
+  if (flat_forest_){
+    score_blocks(rows, num_threads, [&](size_t i, const ForestScore& result){ out[i] = result.probability(mode); });
+    return;
+  }
+  ThreadPool::global().parallel_for(rows.size(), [&](size_t i){
+    out[i] = score(rows[i]).probability(mode);
+  }, num_threads);
+}
+
+/**
+ * @brief Number of trees an early-exit prediction needed, summed over many rows.
+*/
+struct EarlyExitStats {
+  size_t rows = 0;
+  size_t trees_evaluated = 0;
+
+  /// @brief Average number of trees evaluated per row.
+  double average_trees() const { return rows == 0 ? 0.0 : trees_evaluated / (double)rows; }
+};
+
+/**
+ * @brief Orders the trees by accuracy on a validation set, most accurate first, so early exits happen sooner.
+ * @param validation_data Rows where the last element is the label.
+*/
+void order_trees_by_accuracy(const vector<vector<double>>& validation_data){
+  vector<int> correct(trees_.size(), 0);
+  for (size_t t = 0; t < trees_.size(); t++){
+    for (const auto& row : validation_data){
+      if (trees_[t].find_leaf(row)->label == static_cast<int>(row.back())) correct[t]++;
+    }
+  }
+  tree_order_.resize(trees_.size());
+  iota(tree_order_.begin(), tree_order_.end(), 0);
+  stable_sort(tree_order_.begin(), tree_order_.end(), [&](size_t a, size_t b){ return correct[a] > correct[b]; });
+}
+
+/**
+ * @brief Majority vote that stops as soon as the remaining trees cannot change the outcome. Labels are assumed to be 0/1.
+ *
+ * Always returns the same label as predict (ties go to 0), usually after far fewer trees.
+ * @param feature Vector of features. Extra trailing values (such as the label) are ignored.
+ * @param stats If given, the row and the number of trees evaluated are added to it.
+*/
+int predict_early_exit(const vector<double>& feature, EarlyExitStats* stats = nullptr) const {
+  require_features(feature.size());
+  size_t total = trees_.size();
+  size_t positive = 0, negative = 0, evaluated = 0;
+  int label = 0;
+  while (evaluated < total){
+    const DecisionTree& tree = trees_[tree_order_.empty() ? evaluated : tree_order_[evaluated]];
+    if (tree.find_leaf(feature)->label == 1) positive++; else negative++;
+    evaluated++;
+    size_t remaining = total - evaluated;
+    if (positive > negative + remaining) { label = 1; break; }
+    if (negative >= positive + remaining) { label = 0; break; }
+  }
+  if (stats){
+    stats->rows++;
+    stats->trees_evaluated += evaluated;
+  }
+  return label;
+}
+
+/**
+ * @brief Probability of label 1 that stops once the outcome against @p threshold is settled.
+ *
+ * With margin 0 it stops only when the remaining trees cannot move the probability across the threshold,
+ * so the side of the threshold always matches predict_proba. With a positive margin it also stops once the running
+ * mean is more than @p margin away from the threshold, trading exactness for fewer trees.
+ * @return The mean over the trees evaluated, which is on the settled side of the threshold.
+*/
+double predict_proba_early_exit(const vector<double>& feature, double threshold = 0.5, double margin = 0.0, ProbabilityMode mode = LeafFrequency, EarlyExitStats* stats = nullptr) const {
+  require_features(feature.size());
+  size_t total = trees_.size();
+  double sum = 0.0;
+  size_t evaluated = 0;
+  while (evaluated < total){
+    const DecisionTree& tree = trees_[tree_order_.empty() ? evaluated : tree_order_[evaluated]];
+    const Node* leaf = tree.find_leaf(feature);
+    sum += mode == VoteFraction ? (leaf->label == 1 ? 1.0 : 0.0) : leaf->value;
+    evaluated++;
+    size_t remaining = total - evaluated;
+    double lowest = sum / total, highest = (sum + remaining) / total;
+    if (lowest >= threshold || highest < threshold) break;
+    if (margin > 0 && fabs(sum / evaluated - threshold) > margin) break;
+  }
+  if (stats){
+    stats->rows++;
+    stats->trees_evaluated += evaluated;
+  }
+  return evaluated == 0 ? 0.0 : sum / evaluated;
+}
+
+/**
+ * @brief Batch version of predict_early_exit on the shared pool. @p out is resized to rows.size().
+*/
+void predict_early_exit_batch(const vector<vector<double>>& rows, vector<int>& out, EarlyExitStats* stats = nullptr, size_t num_threads = 0) const {
+  require_rows(rows);
+  out.resize(rows.size());
+  vector<EarlyExitStats> row_stats(rows.size());
+  ThreadPool::global().parallel_for(rows.size(), [&](size_t i){
+    out[i] = predict_early_exit(rows[i], &row_stats[i]);
+  }, num_threads);
+  if (stats){
+    for (const auto& row : row_stats){
+      stats->rows += row.rows;
+      stats->trees_evaluated += row.trees_evaluated;
+    }
+  }
+}
+
 /**
  * @brief Evaluates the accuracy of the random forest on a test dataset.
  * @param test_data The test dataset.
@@ -81,18 +413,31 @@ int predict(const vector<double>& feature){
 */
 
 double evaluate(const vector<vector<double>>& test_data) {
+  vector<int> predicted;
+  predict_batch(test_data, predicted);
   int correct_predictions = 0;
-  for (const auto& data_point : test_data) {
-    vector<double> features(data_point.begin(), data_point.end() - 1);           //Assuming last element is the label
-    int true_label = static_cast<int>(data_point.back());
-    int predicted = predict(features);
-    if (predicted == true_label){
+  for (size_t i = 0; i < test_data.size(); i++){
+    if (predicted[i] == static_cast<int>(test_data[i].back())){          //Assuming last element is the label
       correct_predictions++;
     }
   }
   return static_cast<double>(correct_predictions) / test_data.size();
 }
 
+/**
+ * @brief predict for many rows on the shared pool. The rows are read in place, so a trailing label is ignored rather than copied off.
+ * @param out Resized to rows.size().
+*/
+void predict_batch(const vector<vector<double>>& rows, vector<int>& out, size_t num_threads = 0) {
+  LRP_PHASE("forest.predict_batch");
+  LRP_COUNT(RowsScored, rows.size());
+  require_rows(rows);
+  out.resize(rows.size());
+  ThreadPool::global().parallel_for(rows.size(), [&](size_t i){
+    out[i] = predict(rows[i]);
+  }, num_threads);
+}
+
 /**
  * @brief Perform k-fold cross-validation on the dataset.
  * @param data The dataset to be used in the corss-validation.
@@ -104,8 +449,7 @@ double kFoldCrossValidation(const vector<vector<double>>& data, int k){
   vector<int> indices(n);
   iota(indices.begin(), indices.end(), 0);            //Fill indices with 0, 1,..., n - 1
 
-  random_device rd;
-  mt19937 g(rd());
+  mt19937 g(rng());
   shuffle(indices.begin(), indices.end(), g);
 
   int foldSize = n / k;
@@ -125,7 +469,10 @@ double kFoldCrossValidation(const vector<vector<double>>& data, int k){
       }
     }
 
-    RandomForest model(num_trees_);
+    RandomForest model(num_trees_, tree_options_);
+    model.bootstrap_ = bootstrap_;
+    model.holdout_fraction_ = holdout_fraction_;
+    model.set_seed(rng());
     model.train(trainSet);
     double score = model.evaluate(testSet);
     scores.push_back(score);
@@ -148,13 +495,16 @@ struct AccuracyMetrics
   }
 };
 
+/**
+ * @brief Majority-vote confusion counts on labelled rows. Metrics.h adds AUC, log-loss and calibration from one scoring pass.
+*/
 AccuracyMetrics evaluate_accuracy(const vector<vector<double>>& test_data){
   AccuracyMetrics metrics;
-  for (const auto& sample : test_data){
-    vector<double> features = sample;
-    int true_label = static_cast<int>(features.back());
-    features.pop_back();
-    int predicted_label = predict(features);
+  vector<int> predicted;
+  predict_batch(test_data, predicted);
+  for (size_t i = 0; i < test_data.size(); i++){
+    int true_label = static_cast<int>(test_data[i].back());
+    int predicted_label = predicted[i];
     if (predicted_label == true_label){
       if(predicted_label == 1) metrics.true_positives++;
       else metrics.true_negatives++;
@@ -168,8 +518,11 @@ AccuracyMetrics evaluate_accuracy(const vector<vector<double>>& test_data){
 }
 
 static void splitData(const vector<vector<double>>& data, vector<vector<double>>& train_data, vector<vector<double>>& test_data, double test_size){
-    random_device rd;
-    mt19937 g(rd());
+    mt19937 g(random_device{}());
+    splitData(data, train_data, test_data, test_size, g);
+  }
+
+static void splitData(const vector<vector<double>>& data, vector<vector<double>>& train_data, vector<vector<double>>& test_data, double test_size, mt19937& g){
     vector<int> indices(data.size());
     iota(indices.begin(), indices.end(), 0);
     shuffle(indices.begin(), indices.end(), g);
@@ -183,21 +536,205 @@ static void splitData(const vector<vector<double>>& data, vector<vector<double>>
     }
   }
 
-  vector<vector<double>> createBootstrapSample(const vector<vector<double>>& data){
+  static vector<vector<double>> createBootstrapSample(const vector<vector<double>>& data, mt19937& sample_rng){
     vector<vector<double>> samples;
-    uniform_int_distribution<> dist(0, data.size() - 1);
-    for (size_t j = 0; j < data.size(); ++j){
-      size_t idx = dist(rng);
+    samples.reserve(data.size());
+    for (size_t idx : createBootstrapIndices(data.size(), sample_rng)){
       samples.push_back(data[idx]);
     }
     return samples;
   }
 
+  /**
+    *@brief Draws @p n row indexes in [0, n) with replacement, the rows createBootstrapSample would copy with the same generator.
+    */
+  static vector<size_t> createBootstrapIndices(size_t n, mt19937& sample_rng){
+    vector<size_t> rows(n);
+    uniform_int_distribution<> dist(0, n - 1);
+    for (size_t j = 0; j < n; ++j){
+      rows[j] = dist(sample_rng);
+    }
+    return rows;
+  }
+
+/**
+ * @brief Writes the forest in the model file format: a "RandomForest <num_trees> <num_features>" header, an optional
+ * "order ..." line with the early-exit evaluation order, then every tree (see DecisionTree::save).
+*/
+void save(ostream& out) const {
+  out << "RandomForest " << num_trees_ << " " << num_features_ << "\n";
+  if (!tree_order_.empty()){
+    out << "order";
+    for (size_t index : tree_order_) out << " " << index;
+    out << "\n";
+  }
+  for (const auto& tree : trees_){
+    tree.save(out);
+  }
+}
+
+void save(const string& path) const {
+  ofstream out(path);
+  if (!out) throw runtime_error("Cannot open model file for writing: " + path);
+  save(out);
+}
+
+/**
+ * @brief Engine used by predict, score and the batch scorers. Early-exit predictors always walk the trees in order.
+*/
+enum InferenceBackend {
+  TraversalBackend,     //< Walk every tree from its root (DecisionTree::find_leaf).
+  QuickScorerBackend,   //< Feature-ordered bitvector scoring (QuickScorer.h), same results.
+  SimdBackend,          //< Flat arrays walked by several rows at once in the batch scorers (FlatForest.h), same results.
+  QuantizedBackend      //< 8-byte packed nodes with threshold indexes into a per-feature threshold table (QuantizedForest.h), same results.
+};
+
+/**
+ * @brief Selects the inference engine, building its tables from the current trees.
+*/
+void set_inference_backend(InferenceBackend backend){
+  backend_ = backend;
+  if (backend == QuickScorerBackend) quick_scorer_.reset(new QuickScorer(trees_));
+  else quick_scorer_.reset();
+  if (backend == SimdBackend) flat_forest_.reset(new FlatForest(trees_));
+  else flat_forest_.reset();
+  if (backend == QuantizedBackend) quantized_forest_.reset(new QuantizedForest(trees_));
+  else quantized_forest_.reset();
+}
+
+InferenceBackend get_inference_backend() const { return backend_; }
+
+/**
+ * @brief Replaces the forest with one read from a model file written by save.
+ *
+ * Files written before the header carried the feature count take it from the largest feature the trees split on.
+ * @param backend Inference engine to prepare for the loaded trees.
+ * @throws runtime_error if the file is missing or malformed, or a tree splits on a feature past the feature count.
+*/
+void load(istream& in, InferenceBackend backend = TraversalBackend){
+  string header;
+  getline(in, header);
+  istringstream header_fields(header);
+  string kind;
+  int num_trees = 0;
+  if (!(header_fields >> kind >> num_trees) || kind != "RandomForest" || num_trees < 0) throw runtime_error("Not a RandomForest model file.");
+  long long num_features = -1;
+  if (header_fields >> num_features && num_features < 0) throw runtime_error("Invalid feature count in model file.");
+  vector<size_t> order;
+  if (in.peek() == 'o'){
+    string line;
+    getline(in, line);
+    istringstream fields(line.substr(line.find(' ') + 1));
+    for (size_t index; fields >> index;) order.push_back(index);
+    //the early-exit predictors index trees_ with it, so it must be a permutation of the trees
+    vector<bool> seen(order.size(), false);
+    bool permutation = order.size() == static_cast<size_t>(num_trees);
+    for (size_t k = 0; permutation && k < order.size(); k++){
+      permutation = order[k] < order.size() && !seen[order[k]];
+      if (permutation) seen[order[k]] = true;
+    }
+    if (!permutation) throw runtime_error("Invalid tree order in model file.");
+  }
+  vector<DecisionTree> trees(num_trees);
+  long long needed = 0;
+  for (auto& tree : trees){
+    tree.load(in);
+    needed = max(needed, tree.max_split_feature() + 1LL);
+  }
+  if (num_features < 0) num_features = needed;
+  else if (needed > num_features) throw runtime_error("Model file splits on feature " + to_string(needed - 1) + " but declares " + to_string(num_features) + " features.");
+  num_trees_ = num_trees;
+  num_features_ = static_cast<size_t>(num_features);
+  trees_ = move(trees);
+  tree_order_ = move(order);
+  set_inference_backend(backend);
+}
+
+void load(const string& path, InferenceBackend backend = TraversalBackend){
+  ifstream in(path);
+  if (!in) throw runtime_error("Cannot open model file: " + path);
+  load(in, backend);
+}
+
+/// @brief Returns the trained trees, for code that walks the forest.
+const vector<DecisionTree>& get_trees() const { return trees_; }
+
+/// @brief Number of feature columns the forest was trained on; every scored row must hold at least this many values.
+size_t num_features() const { return num_features_; }
+
+/**
+ * @brief Checks that rows of @p available values, such as a RowEncoder's output, cover every feature the forest reads.
+ * @throws invalid_argument otherwise, as the backends index rows without bounds checks.
+*/
+void require_features(size_t available) const {
+  if (available < num_features_) throw invalid_argument("Rows have " + to_string(available) + " values but the model needs " + to_string(num_features_) + " features.");
+}
+
+protected:
+  /// @brief Whether every tree is trained on a bootstrap sample (true) or on the whole training split.
+  bool bootstrap_ = true;
+  /// @brief Share of the rows train holds out.
+  double holdout_fraction_ = 0.2;
+
 private:
   /// @brief Number of trees in the forest.
   int num_trees_;
+  /// @brief Feature columns of the training data, or declared by the loaded model file.
+  size_t num_features_ = 0;
+  /// @brief Pre-pruning limits passed to every tree.
+  TreeOptions tree_options_;
   /// @brief Vector of decision trees.
   vector<DecisionTree> trees_;
+  /// @brief Evaluation order used by the early-exit predictors, empty for training order.
+  vector<size_t> tree_order_;
+  /// @brief Selected inference engine.
+  InferenceBackend backend_ = TraversalBackend;
+  /// @brief QuickScorer tables, built only when that backend is selected.
+  unique_ptr<QuickScorer> quick_scorer_;
+  /// @brief Flat SIMD tables, built only when that backend is selected.
+  unique_ptr<FlatForest> flat_forest_;
+  /// @brief Quantized threshold tables, built only when that backend is selected.
+  unique_ptr<QuantizedForest> quantized_forest_;
+
+  /// @brief require_features for every row of a batch, checked before any backend reads them.
+  void require_rows(const vector<vector<double>>& rows) const {
+    for (const auto& row : rows) require_features(row.size());
+  }
+
+  /// @brief Trains tree @p i on the rows of @p data listed in @p rows.
+  void train_tree(size_t i, const vector<vector<double>>& data, const vector<size_t>& rows, unsigned int seed, const BinnedMatrix* binned){
+    LRP_LOG_DEBUG("forest.train_tree", "Training tree " << (i + 1) << " of " << num_trees_ << " on a sample of " << rows.size() << " rows");
+    trees_[i].set_seed(seed);
+    trees_[i].train_rows(data, rows, {}, binned);
+  }
+
+  /// @brief Quantizes @p data once for every tree if histogram splits are on, null otherwise.
+  unique_ptr<BinnedMatrix> bin_data(const vector<vector<double>>& data) const {
+    if (tree_options_.max_bins <= 0 || tree_options_.split_mode != BestSplit || data.empty()) return nullptr;
+    LRP_PHASE("forest.train/bin");
+    return unique_ptr<BinnedMatrix>(new BinnedMatrix(data, data[0].size() - 1, tree_options_.max_bins, tree_options_.num_threads));
+  }
+
+  /// @brief Runs the flat forest over blocks of rows on the shared pool and hands every row's score to fn(i, score).
+  template <typename Fn>
+  void score_blocks(const vector<vector<double>>& rows, size_t num_threads, Fn&& fn, size_t feature = 0, const double* column = nullptr) const {
+    const size_t block = FlatForest::kBlockRows;
+    FlatForest::SimdLevel level = FlatForest::detect();
+    ThreadPool::global().parallel_for((rows.size() + block - 1) / block, [&](size_t b){
+      size_t begin = b * block, end = min(rows.size(), begin + block);
+      int votes[FlatForest::kBlockRows];
+      double sums[FlatForest::kBlockRows];
+      flat_forest_->score_rows(rows, begin, end, votes, sums, level, feature, column);
+      for (size_t i = begin; i < end; i++){
+        ForestScore result;
+        if (!trees_.empty()){
+          result.vote_fraction = votes[i - begin] / (double)trees_.size();
+          result.leaf_frequency = sums[i - begin] / trees_.size();
+        }
+        fn(i, result);
+      }
+    }, num_threads);
+  }
 
   mt19937 rng;
 };
@@ -13,6 +13,7 @@
 #include <iostream>
 #include <vector>
 #include <cmath>
+#include <limits>
 #include "../Includes/DataFrame.h"
 
 /// @brief For negatively classified predictions, this class finds the closest positive evaluation within the same categories (the credit policy and purpose will be the same) of the negative entries.
@@ -21,36 +22,55 @@ class SuggestionGenerator {
     /// @brief Returns the closest positive data point within the same categories of the negative data point.
     /// @param negative_point The negatively classified point.
     /// @param df The DataFrame object to search in.
-    /// @return The closest positive data point within the same category.
-    std::vector<double> get_closest_positive_prediction(std::vector<double> negative_point, DataFrame *df) {
-        int curr_max_dist = -1;
-        int curr_max_row_index = -1;
-        negative_point = df->normalize(negative_point);
-        for(int row = 0; row < df->get_normalized_vector().size(); row++) {
+    /// @return The closest positive data point within the same category, empty if there is none.
+    std::vector<double> get_closest_positive_prediction(const std::vector<double>& negative_point, DataFrame *df) {
+        int row = get_closest_positive_row(negative_point, df);
+        return row < 0 ? std::vector<double>() : df->get_data_vec()[row];
+    }
+
+    /// @brief Returns the row index of the closest positive data point within the same categories of the negative data point.
+    /// @param negative_point The negatively classified point.
+    /// @param df The DataFrame object to search in.
+    /// @return Row index in the DataFrame, -1 if no paid back loan shares the point's categories.
+    int get_closest_positive_row(const std::vector<double>& negative_point, DataFrame *df) {
+        double curr_min_dist = std::numeric_limits<double>::max();
+        int curr_min_row_index = -1;
+        std::vector<double> normalized_point = df->normalize(negative_point);
+        const std::vector<std::vector<double>>& normalized_rows = df->get_normalized_vector(); // a reference, the rows are not copied per query
+        std::vector<int> categorical_columns = df->get_all_categorical_columns();
+        for(size_t row = 0; row < normalized_rows.size(); row++) {
             // if the borrower didnt pay back the loan, we skip it
             if(!(df->paid_back_loan(row))) continue;
 
-            std::vector<double> compared_point = df->get_normalized_vector()[row];
+            const std::vector<double>& compared_point = normalized_rows[row];
 
             // the borrower's information and the compared information need to be in the same categories
             // otherwise the data will be too irrelevant, so we skip it.
-            if(!df->in_same_category(negative_point, compared_point)) continue;
+            bool same_category = true;
+            for(int col : categorical_columns) {
+                if(normalized_point[col] != compared_point[col]) {
+                    same_category = false;
+                    break;
+                }
+            }
+            if(!same_category) continue;
 
-            int distance = distance_between_points(negative_point, compared_point); // manhattan distance calculation
-            if(distance > curr_max_dist) {
-                curr_max_dist = distance;
-                curr_max_row_index = row;
+            double distance = distance_between_points(normalized_point, compared_point); // manhattan distance calculation
+            if(distance < curr_min_dist) {
+                curr_min_dist = distance;
+                curr_min_row_index = row;
             }
         }
-        return df->get_data_vec()[curr_max_row_index];
+        return curr_min_row_index;
     }
+
     /// @brief Calculates the manhattan distance between two vectors.
     /// @param p1 Point 1
     /// @param p2 Point 2
     /// @return Distance between the two vectors.
-    double distance_between_points(std::vector<double> p1, std::vector<double> p2) {
+    double distance_between_points(const std::vector<double>& p1, const std::vector<double>& p2) {
         double current_distance = 0.0;
-        for(size_t col = 0; col < p1.size(); col++) {
+        for(size_t col = 0; col < p1.size() && col < p2.size(); col++) {
             current_distance += std::abs(p1[col] - p2[col]);
         }
         return current_distance;
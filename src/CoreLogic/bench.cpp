@@ -0,0 +1,333 @@
+// Microbenchmarks for the training and inference hot paths.
+//
+// A small self-contained harness in the style of Google Benchmark: every benchmark runs for at least
+// --benchmark_min_time seconds, and results are printed as a console table, or as Google Benchmark
+// compatible JSON with --benchmark_format=json / --benchmark_out=<file>, so runs can be compared across releases.
+//
+// Usage: bench [--data=<loan_data.csv>] [--benchmark_filter=<regex>] [--benchmark_min_time=<seconds>]
+//              [--benchmark_format=console|json] [--benchmark_out=<file>] [--trace_out=<file>]
+//              [--instrumentation_out=<file>]
+//
+// --trace_out writes a Chrome trace and --instrumentation_out the counters and phase times of the forest trained for the benchmarks.
+#include "RandomForest.h"
+#include "SuggestionGenerator.h"
+#include "../DataProcessing/DataHandler.h"
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// @brief Keeps the compiler from optimizing away a benchmarked result.
+template <typename T>
+inline void do_not_optimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/// @brief Passed to every benchmark: run the measured code iterations() times and report the items processed.
+class BenchState {
+public:
+    explicit BenchState(size_t iterations) : iterations_(iterations) {}
+    size_t iterations() const { return iterations_; }
+    void set_items_processed(size_t items) { items_ = items; }
+    size_t items_processed() const { return items_; }
+
+    /// @brief Excludes the code up to resume_timing() from the measured time, such as restoring inputs between iterations.
+    void pause_timing() {
+        pause_wall_ = std::chrono::steady_clock::now();
+        pause_cpu_ = std::clock();
+    }
+    void resume_timing() {
+        paused_wall_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - pause_wall_).count();
+        paused_cpu_ += double(std::clock() - pause_cpu_) / CLOCKS_PER_SEC;
+    }
+    double paused_wall() const { return paused_wall_; }
+    double paused_cpu() const { return paused_cpu_; }
+private:
+    size_t iterations_;
+    size_t items_ = 0;
+    std::chrono::steady_clock::time_point pause_wall_;
+    std::clock_t pause_cpu_ = 0;
+    double paused_wall_ = 0.0;
+    double paused_cpu_ = 0.0;
+};
+
+struct BenchResult {
+    std::string name;
+    size_t iterations;
+    double real_time_ns;     // per iteration
+    double cpu_time_ns;      // per iteration, process CPU time (includes the shared pool's workers)
+    double items_per_second;
+};
+
+class BenchRegistry {
+public:
+    void add(const std::string& name, std::function<void(BenchState&)> fn) { benchmarks_.push_back({name, fn}); }
+
+    std::vector<BenchResult> run(const std::regex& filter, double min_time) const {
+        std::vector<BenchResult> results;
+        for (const auto& bench : benchmarks_) {
+            if (!std::regex_search(bench.first, filter)) continue;
+            // grow the iteration count until one batch runs for min_time, like Google Benchmark
+            size_t iterations = 1;
+            while (true) {
+                BenchState state(iterations);
+                auto wall_start = std::chrono::steady_clock::now();
+                std::clock_t cpu_start = std::clock();
+                bench.second(state);
+                double cpu = double(std::clock() - cpu_start) / CLOCKS_PER_SEC - state.paused_cpu();
+                double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count() - state.paused_wall();
+                if (wall >= min_time || iterations >= 1000000000) {
+                    results.push_back({bench.first, iterations, wall * 1e9 / iterations, cpu * 1e9 / iterations,
+                                       state.items_processed() / wall});
+                    break;
+                }
+                double scale = wall <= 0 ? 10.0 : std::min(10.0, std::max(1.5, 1.4 * min_time / wall));
+                iterations = static_cast<size_t>(iterations * scale) + 1;
+            }
+        }
+        return results;
+    }
+
+private:
+    std::vector<std::pair<std::string, std::function<void(BenchState&)>>> benchmarks_;
+};
+
+static std::string json_escape(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
+static void write_json(std::ostream& out, const std::vector<BenchResult>& results) {
+    char date[64];
+    std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+    out << "{\n  \"context\": {\n";
+    out << "    \"date\": \"" << date << "\",\n";
+    out << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n";
+#ifdef NDEBUG
+    out << "    \"library_build_type\": \"release\"\n";
+#else
+    out << "    \"library_build_type\": \"debug\"\n";
+#endif
+    out << "  },\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        out << "    {\n";
+        out << "      \"name\": \"" << json_escape(r.name) << "\",\n";
+        out << "      \"run_type\": \"iteration\",\n";
+        out << "      \"iterations\": " << r.iterations << ",\n";
+        out << "      \"real_time\": " << r.real_time_ns << ",\n";
+        out << "      \"cpu_time\": " << r.cpu_time_ns << ",\n";
+        out << "      \"time_unit\": \"ns\"";
+        if (r.items_per_second > 0) out << ",\n      \"items_per_second\": " << r.items_per_second;
+        out << "\n    }" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+static void write_console(std::ostream& out, const std::vector<BenchResult>& results) {
+    char line[256];
+    std::snprintf(line, sizeof(line), "%-48s %15s %15s %12s %14s\n", "Benchmark", "Time (ns)", "CPU (ns)", "Iterations", "Items/s");
+    out << line << std::string(108, '-') << "\n";
+    for (const auto& r : results) {
+        std::snprintf(line, sizeof(line), "%-48s %15.0f %15.0f %12zu %14.4g\n", r.name.c_str(), r.real_time_ns, r.cpu_time_ns, r.iterations, r.items_per_second);
+        out << line;
+    }
+}
+
+/// @brief Writes the CSV body repeated @p copies times under one header, an up-scaled copy of the dataset.
+static std::string write_upscaled_csv(const std::string& path, size_t copies) {
+    std::ifstream in(path);
+    std::string header, line, body;
+    std::getline(in, header);
+    while (std::getline(in, line)) body += line + "\n";
+    std::string out_path = "bench_upscaled_x" + std::to_string(copies) + ".csv";
+    std::ofstream out(out_path);
+    out << header << "\n";
+    for (size_t i = 0; i < copies; i++) out << body;
+    return out_path;
+}
+
+static DataFrame* load_frame(const std::string& path) {
+    std::ifstream csv(path);
+    if (!csv) throw std::runtime_error("Cannot open " + path);
+    DataHandler handler;
+    return handler.process_data(csv, {0, 1});
+}
+
+int main(int argc, char* argv[]) {
+    std::string data_path = "../../data/loan_data.csv";
+    std::string filter = ".*", format = "console", out_path, trace_path, instrumentation_path;
+    double min_time = 0.5;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto value = [&](const std::string& flag) { return arg.substr(flag.size()); };
+        if (arg.rfind("--data=", 0) == 0) data_path = value("--data=");
+        else if (arg.rfind("--benchmark_filter=", 0) == 0) filter = value("--benchmark_filter=");
+        else if (arg.rfind("--benchmark_min_time=", 0) == 0) min_time = std::stod(value("--benchmark_min_time="));
+        else if (arg.rfind("--benchmark_format=", 0) == 0) format = value("--benchmark_format=");
+        else if (arg.rfind("--benchmark_out=", 0) == 0) out_path = value("--benchmark_out=");
+        else if (arg.rfind("--trace_out=", 0) == 0) trace_path = value("--trace_out=");
+        else if (arg.rfind("--instrumentation_out=", 0) == 0) instrumentation_path = value("--instrumentation_out=");
+        else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    // training and ingest log through Logger, which writes to clog, so cout only carries the results
+    std::unique_ptr<DataFrame> frame(load_frame(data_path));
+    const std::vector<std::vector<double>> data = frame->get_data_vec();
+    std::vector<std::vector<double>> features(data.size());
+    std::vector<int> labels(data.size());
+    for (size_t i = 0; i < data.size(); i++) {
+        features[i].assign(data[i].begin(), data[i].end() - 1);
+        labels[i] = static_cast<int>(data[i].back());
+    }
+    const std::vector<std::string> names = frame->get_feature_name_vec();
+    const size_t int_rate = std::find(names.begin(), names.end(), "int.rate") - names.begin();
+    if (int_rate >= features[0].size()) {
+        std::cerr << "No int.rate column in " << data_path << std::endl;
+        return 1;
+    }
+
+    DecisionTree tree;
+    {
+        std::vector<std::vector<double>> train = data;
+        tree.train(train);
+    }
+    Instrumentation::global().reset();
+    Instrumentation::global().set_tracing(!trace_path.empty());
+    RandomForest forest(100);
+    forest.train(data);
+    Instrumentation::global().set_tracing(false);
+    if (!trace_path.empty()) {
+        std::ofstream trace(trace_path);
+        Instrumentation::global().write_chrome_trace(trace);
+    }
+    if (!instrumentation_path.empty()) {
+        std::ofstream report(instrumentation_path);
+        Instrumentation::global().write_json(report);
+    }
+
+    BenchRegistry registry;
+
+    // training primitives
+    registry.add("BM_calculate_gini_index", [&](BenchState& state) {
+        DecisionTree t;
+        std::map<double, int> left = {{0, 4000}, {1, 700}}, right = {{0, 4045}, {1, 833}};
+        for (size_t i = 0; i < state.iterations(); i++) do_not_optimize(t.calculate_gini_index(left, right, 4700, 4878));
+    });
+    registry.add("BM_find_best_split/int_rate", [&](BenchState& state) {
+        DecisionTree t;
+        for (size_t i = 0; i < state.iterations(); i++) do_not_optimize(t.find_best_split(features, labels, 0, features.size(), int_rate));
+        state.set_items_processed(state.iterations() * features.size());
+    });
+    registry.add("BM_partition_data/int_rate", [&](BenchState& state) {
+        DecisionTree t;
+        std::vector<std::vector<double>> rows = data;
+        for (size_t i = 0; i < state.iterations(); i++) {
+            // partitioning reorders the rows; restore them so every iteration partitions the original order
+            state.pause_timing();
+            rows = data;
+            state.resume_timing();
+            do_not_optimize(t.partition_data(rows, 0, rows.size(), int_rate, 0.12));
+        }
+        state.set_items_processed(state.iterations() * rows.size());
+    });
+    registry.add("BM_tree_train", [&](BenchState& state) {
+        for (size_t i = 0; i < state.iterations(); i++) {
+            std::vector<std::vector<double>> train = data;
+            DecisionTree t;
+            t.train(train);
+            do_not_optimize(t.get_root());
+        }
+        state.set_items_processed(state.iterations() * data.size());
+    });
+
+    // inference
+    registry.add("BM_tree_predict/single", [&](BenchState& state) {
+        for (size_t i = 0; i < state.iterations(); i++) do_not_optimize(tree.find_leaf(features[i % features.size()])->label);
+        state.set_items_processed(state.iterations());
+    });
+    registry.add("BM_tree_predict/batch", [&](BenchState& state) {
+        for (size_t i = 0; i < state.iterations(); i++) {
+            for (const auto& row : features) do_not_optimize(tree.find_leaf(row)->label);
+        }
+        state.set_items_processed(state.iterations() * features.size());
+    });
+    const std::vector<std::pair<std::string, RandomForest::InferenceBackend>> backends = {
+        {"traversal", RandomForest::TraversalBackend}, {"quickscorer", RandomForest::QuickScorerBackend},
+        {"simd", RandomForest::SimdBackend}, {"quantized", RandomForest::QuantizedBackend}};
+    for (const auto& backend : backends) {
+        // building the backend's tables is not scoring; keep it out of every calibration and measured run
+        registry.add("BM_forest_predict/single/" + backend.first, [&, backend](BenchState& state) {
+            state.pause_timing();
+            forest.set_inference_backend(backend.second);
+            state.resume_timing();
+            for (size_t i = 0; i < state.iterations(); i++) do_not_optimize(forest.score(features[i % features.size()]));
+            state.set_items_processed(state.iterations());
+        });
+        registry.add("BM_forest_predict/batch/" + backend.first, [&, backend](BenchState& state) {
+            state.pause_timing();
+            forest.set_inference_backend(backend.second);
+            state.resume_timing();
+            std::vector<double> proba;
+            for (size_t i = 0; i < state.iterations(); i++) {
+                forest.predict_proba_batch(features, proba);
+                do_not_optimize(proba.data());
+            }
+            state.set_items_processed(state.iterations() * features.size());
+        });
+    }
+
+    // ingest; the upscaled copies are written once here, not in the timed body, and only if their benchmark is selected
+    const std::regex selected(filter);
+    std::vector<std::string> upscaled_paths;
+    for (size_t copies : {1, 4, 16}) {
+        std::string name = "BM_process_data/x" + std::to_string(copies);
+        if (!std::regex_search(name, selected)) continue;
+        std::string path = data_path;
+        if (copies != 1) {
+            path = write_upscaled_csv(data_path, copies);
+            upscaled_paths.push_back(path);
+        }
+        registry.add(name, [&, copies, path](BenchState& state) {
+            for (size_t i = 0; i < state.iterations(); i++) {
+                std::unique_ptr<DataFrame> df(load_frame(path));
+                do_not_optimize(df.get());
+            }
+            state.set_items_processed(state.iterations() * data.size() * copies);
+        });
+    }
+
+    // suggestions
+    registry.add("BM_suggestion_query", [&](BenchState& state) {
+        SuggestionGenerator generator;
+        for (size_t i = 0; i < state.iterations(); i++) {
+            do_not_optimize(generator.get_closest_positive_prediction(data[(i * 97) % data.size()], frame.get()));
+        }
+        state.set_items_processed(state.iterations());
+    });
+
+    std::vector<BenchResult> results = registry.run(selected, min_time);
+    for (const std::string& path : upscaled_paths) std::remove(path.c_str());
+    if (format == "json") write_json(std::cout, results);
+    else write_console(std::cout, results);
+    if (!out_path.empty()) {
+        std::ofstream out(out_path);
+        write_json(out, results);
+    }
+    return 0;
+}
@@ -1,6 +1,39 @@
 #include "acutest.h"
 #include "DecisionTree.h"
+#include "HoeffdingTree.h"
+#include "ExtraTrees.h"
+#include "GradientBoosting.h"
+#include "CompiledForest.h"
+#include "HyperparameterSearch.h"
+#include "FeatureImportance.h"
+#include "Metrics.h"
+#include "SuggestionGenerator.h"
+#include "../DataProcessing/SyntheticData.h"
+#include "../DataProcessing/RowEncoder.h"
+#include "../Includes/MicroBatcher.h"
+#include <sstream>
 #include <cmath>
+#include <atomic>
+#include <random>
+#include <set>
+
+// @p count rows of @p num_features uniform [0, 1) values drawn from mt19937(@p seed), each followed by a 0/1 label from
+// label(row, uniform); the label may call uniform() for noise, drawn right after the row's features
+template <typename Label>
+static std::vector<std::vector<double>> random_rows(unsigned int seed, int count, size_t num_features, Label label) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> dist(0.0, 1.0);
+    auto uniform = [&] { return dist(rng); };
+    std::vector<std::vector<double>> rows;
+    rows.reserve(count);
+    for (int i = 0; i < count; i++) {
+        std::vector<double> row(num_features);
+        for (double& value : row) value = uniform();
+        row.push_back(label(row, uniform) ? 1.0 : 0.0);
+        rows.push_back(std::move(row));
+    }
+    return rows;
+}
 
 void test_best_split(void) {
     DecisionTree tree;
@@ -71,6 +104,835 @@ void test_split_not_possible(void) {
     TEST_CHECK(split_index == 3);  // Expecting the split index to be in the middle
 }
 
+void test_max_depth_limits_tree(void) {
+    TreeOptions options;
+    options.max_depth = 1;
+    DecisionTree tree(options);
+    std::vector<std::vector<double>> data = {
+        {1, 0}, {2, 1}, {3, 0}, {4, 1}, {5, 0}, {6, 1}, {7, 1}, {8, 1}
+    };
+    tree.train(data);
+    // a single split can only separate a prefix of the rows, the remaining mix takes the majority label
+    const Node* root = tree.get_root();
+    TEST_ASSERT(root != nullptr && !root->is_leaf);
+    TEST_CHECK(root->left->is_leaf && root->right->is_leaf);
+    TEST_CHECK(tree.predict({8}) == 1);
+    // {4} is labelled 1 but shares the depth-1 leaf of {1}..{5}, whose majority is 0; a deeper tree would isolate it
+    TEST_CHECK(tree.predict({4}) == 0);
+}
+
+// largest feature index any split of the tree below @p root tests, -1 for a single leaf
+static int max_split_feature(const Node* root) {
+    std::vector<const Node*> nodes = {root};
+    int largest = -1;
+    while (!nodes.empty()) {
+        const Node* node = nodes.back();
+        nodes.pop_back();
+        if (node->is_leaf) continue;
+        largest = std::max(largest, node->feature_index);
+        nodes.push_back(node->left.get());
+        nodes.push_back(node->right.get());
+    }
+    return largest;
+}
+
+void test_tree_never_splits_on_label(void) {
+    // labels unrelated to the two features; the label column itself would be the perfect split
+    std::vector<std::vector<double>> data = random_rows(31, 400, 2, [](const std::vector<double>&, auto& uniform) { return uniform() < 0.5; });
+    DecisionTree tree;
+    tree.train(data);
+    TEST_CHECK(max_split_feature(tree.get_root()) < 2);
+}
+
+void test_min_samples_leaf(void) {
+    DecisionTree tree;
+    std::vector<std::vector<double>> features = {{1}, {2}, {3}, {4}, {5}, {6}};
+    std::vector<int> labels = {0, 1, 1, 1, 1, 1};
+    auto unrestricted = tree.find_best_split(features, labels, 0, features.size(), 0);
+    TEST_CHECK(unrestricted.threshold == 2);
+    auto restricted = tree.find_best_split(features, labels, 0, features.size(), 0, 3);
+    TEST_CHECK(restricted.threshold == 4);
+}
+
+void test_thread_pool_nested_parallel_for(void) {
+    ThreadPool pool(3);
+    std::vector<int> counts(64, 0);
+    pool.parallel_for(8, [&](size_t i) {
+        pool.parallel_for(8, [&](size_t j) { counts[i * 8 + j]++; });
+    });
+    bool all_once = true;
+    for (int count : counts) all_once = all_once && count == 1;
+    TEST_CHECK(all_once);
+}
+
+void test_thread_pool_rethrows_on_caller(void) {
+    ThreadPool pool(3);
+    // the caller must not unwind while helpers still run fn, which reads its stack
+    std::vector<int> on_caller_stack(1000, 1);
+    bool thrown = false;
+    try {
+        pool.parallel_for(on_caller_stack.size(), [&](size_t i) {
+            if (i == 37) throw std::runtime_error("bad row");
+            on_caller_stack[i]++;
+        });
+    } catch (const std::runtime_error& error) {
+        thrown = std::string(error.what()) == "bad row";
+    }
+    TEST_CHECK(thrown);
+    // whichever thread runs a throwing call, worker or caller, the exception reaches the caller
+    TEST_EXCEPTION(pool.parallel_for(64, [&](size_t) { throw std::runtime_error("every row"); }), std::runtime_error);
+    // the pool survives and runs the next loop in full
+    std::atomic<int> sum{0};
+    pool.parallel_for(100, [&](size_t i) { sum += (int)i; });
+    TEST_CHECK(sum.load() == 4950);
+}
+
+void test_feature_parallel_split_matches_serial(void) {
+    std::vector<std::vector<double>> data = random_rows(7, 400, 3, [](const std::vector<double>& x, auto&) { return x[0] + x[1] > 1.0; });
+    TreeOptions serial_options, parallel_options;
+    serial_options.num_threads = 1;
+    parallel_options.parallel_split_min_samples = 1;
+    DecisionTree serial_tree(serial_options), parallel_tree(parallel_options);
+    std::vector<std::vector<double>> serial_data = data, parallel_data = data;
+    serial_tree.train(serial_data);
+    parallel_tree.train(parallel_data);
+    int mismatches = 0;
+    for (const auto& row : data) {
+        if (serial_tree.predict(row) != parallel_tree.predict(row)) mismatches++;
+    }
+    TEST_CHECK(mismatches == 0);
+}
+
+void test_max_features_resolve(void) {
+    TEST_CHECK(MaxFeatures::parse("sqrt").resolve(20) == 4);
+    TEST_CHECK(MaxFeatures::parse("log2").resolve(20) == 4);
+    TEST_CHECK(MaxFeatures::parse("0.5").resolve(20) == 10);
+    TEST_CHECK(MaxFeatures::parse("7").resolve(20) == 7);
+    TEST_CHECK(MaxFeatures::parse("all").resolve(20) == 20);
+    TEST_CHECK(MaxFeatures::parse("0.01").resolve(20) == 1);
+}
+
+void test_random_split_tree(void) {
+    TreeOptions options;
+    options.split_mode = RandomSplit;
+    DecisionTree tree(options);
+    std::vector<std::vector<double>> data;
+    for (int i = 0; i < 100; i++) data.push_back({(double)i, i < 50 ? 0.0 : 1.0});
+    tree.train(data);
+    // random thresholds still separate a clean boundary once the tree is fully grown
+    TEST_CHECK(tree.predict({10}) == 0);
+    TEST_CHECK(tree.predict({49}) == 0);
+    TEST_CHECK(tree.predict({50}) == 1);
+    TEST_CHECK(tree.predict({90}) == 1);
+}
+
+void test_extra_trees_skip_bootstrap_and_split_randomly(void) {
+    std::vector<std::vector<double>> data;
+    for (int i = 0; i < 100; i++) data.push_back({(double)i, i < 30 ? 0.0 : 1.0});
+
+    // depth 0 trees are a single leaf holding the positive share of the rows each tree saw
+    TreeOptions stumps;
+    stumps.max_depth = 0;
+    ExtraTrees leaves(8, stumps);
+    leaves.set_seed(4);
+    leaves.set_holdout_fraction(0);
+    leaves.train(data);
+    for (const DecisionTree& tree : leaves.get_trees()) {
+        TEST_CHECK(tree.get_options().split_mode == RandomSplit);
+        TEST_CHECK(tree.get_root()->value == 0.7);
+    }
+
+    // without bootstrap every tree sees the same rows, so a best split would repeat one threshold across the trees
+    TreeOptions one_split;
+    one_split.max_depth = 1;
+    ExtraTrees forest(8, one_split);
+    forest.set_seed(4);
+    forest.set_holdout_fraction(0);
+    forest.train(data);
+    std::set<double> thresholds;
+    for (const DecisionTree& tree : forest.get_trees()) {
+        TEST_ASSERT(!tree.get_root()->is_leaf);
+        thresholds.insert(tree.get_root()->threshold);
+    }
+    TEST_CHECK(thresholds.size() > 1);
+}
+
+void test_gradient_boosting_learns_boundary(void) {
+    std::vector<std::vector<double>> data = random_rows(3, 2000, 2, [](const std::vector<double>& x, auto&) { return x[0] > 0.6; });
+    GradientBoosting model;
+    model.train(data);
+    TEST_CHECK(model.predict({0.2, 0.5}) == 0);
+    TEST_CHECK(model.predict({0.9, 0.5}) == 1);
+    TEST_CHECK(model.evaluate(data) > 0.95);
+
+    // the model file round-trips to identical probabilities
+    std::stringstream file;
+    model.save(file);
+    GradientBoosting loaded;
+    loaded.load(file);
+    TEST_CHECK(loaded.get_trees().size() == model.get_trees().size());
+    TEST_CHECK(loaded.predict_proba({0.61, 0.3}) == model.predict_proba({0.61, 0.3}));
+    std::stringstream corrupt("GradientBoosting 1000000000000 0.5\nL 0 0.1\nend\n");
+    TEST_EXCEPTION(loaded.load(corrupt), std::runtime_error);
+
+    // histograms built feature-parallel at every node sum to the same trees
+    BoostingOptions options;
+    options.parallel_split_min_samples = 1;
+    GradientBoosting parallel(options);
+    parallel.train(data);
+    TEST_CHECK(parallel.predict_proba({0.61, 0.3}) == model.predict_proba({0.61, 0.3}));
+}
+
+void test_random_forest_save_load(void) {
+    std::vector<std::vector<double>> data;
+    for (int i = 0; i < 60; i++) data.push_back({(double)(i % 7), (double)i, i % 3 == 0 ? 1.0 : 0.0});
+    RandomForest forest(3);
+    forest.train(data);
+    std::stringstream file;
+    forest.save(file);
+    RandomForest loaded(0);
+    loaded.load(file);
+    int mismatches = 0;
+    for (const auto& row : data) {
+        if (loaded.predict(row) != forest.predict(row)) mismatches++;
+    }
+    TEST_CHECK(loaded.get_trees().size() == 3);
+    TEST_CHECK(mismatches == 0);
+}
+
+void test_forest_rejects_rows_short_of_its_features(void) {
+    std::vector<std::vector<double>> data;
+    for (int i = 0; i < 60; i++) data.push_back({(double)(i % 7), (double)i, i % 3 == 0 ? 1.0 : 0.0});
+    RandomForest forest(3);
+    forest.set_seed(2);
+    forest.train(data);
+    TEST_CHECK(forest.num_features() == 2);
+    std::stringstream file;
+    forest.save(file);
+    std::string model = file.str();
+    RandomForest loaded(0);
+    loaded.load(file);
+    TEST_CHECK(loaded.num_features() == 2);
+    TEST_EXCEPTION(loaded.require_features(1), std::invalid_argument);
+
+    // every backend indexes rows without bounds checks, so a short row must be refused up front
+    std::vector<std::vector<double>> rows = {{1.0, 5.0}, {1.0}};
+    std::vector<RandomForest::ForestScore> scores;
+    for (RandomForest::InferenceBackend backend : {RandomForest::TraversalBackend, RandomForest::QuickScorerBackend,
+                                                   RandomForest::SimdBackend, RandomForest::QuantizedBackend}) {
+        loaded.set_inference_backend(backend);
+        TEST_EXCEPTION(loaded.score_batch(rows, scores), std::invalid_argument);
+        TEST_EXCEPTION(loaded.score(rows[1]), std::invalid_argument);
+    }
+
+    // a header declaring fewer features than the trees split on is corrupt; an old header without a count derives it
+    int needed = 0;
+    for (const DecisionTree& tree : loaded.get_trees()) needed = std::max(needed, tree.max_split_feature() + 1);
+    std::string header = model.substr(0, model.find('\n'));
+    std::string body = model.substr(model.find('\n'));
+    std::stringstream too_few("RandomForest 3 " + std::to_string(needed - 1) + body);
+    TEST_EXCEPTION(loaded.load(too_few), std::runtime_error);
+    std::stringstream old_format("RandomForest 3" + body);
+    loaded.load(old_format);
+    TEST_CHECK(loaded.num_features() == (size_t)needed);
+    TEST_CHECK(header == "RandomForest 3 2");
+}
+
+void test_random_forest_probabilities(void) {
+    std::vector<std::vector<double>> data;
+    for (int i = 0; i < 200; i++) data.push_back({(double)i, i >= 100 ? 1.0 : 0.0});
+    RandomForest forest(5);
+    forest.train(data);
+    TEST_CHECK(forest.predict_proba({5}) < 0.5);
+    TEST_CHECK(forest.predict_proba({195}) > 0.5);
+    RandomForest::ForestScore score = forest.score({195});
+    TEST_CHECK(score.vote_fraction == forest.predict_proba({195}, RandomForest::VoteFraction));
+    TEST_CHECK(score.vote_margin() >= 0.0 && score.vote_margin() <= 1.0);
+
+    std::vector<double> batch;
+    forest.predict_proba_batch(data, batch);
+    TEST_CHECK(batch.size() == data.size());
+    TEST_CHECK(batch[195] == forest.predict_proba(data[195]));
+}
+
+void test_early_exit_matches_full_vote(void) {
+    std::vector<std::vector<double>> data = random_rows(11, 300, 2, [](const std::vector<double>& x, auto&) { return x[0] + 0.3 * x[1] > 0.6; });
+    RandomForest forest(15);
+    forest.train(data);
+    forest.order_trees_by_accuracy(data);
+    RandomForest::EarlyExitStats stats;
+    int mismatches = 0, proba_side_mismatches = 0;
+    for (const auto& row : data) {
+        if (forest.predict_early_exit(row, &stats) != forest.predict(row)) mismatches++;
+        bool full_side = forest.predict_proba(row) >= 0.5;
+        bool early_side = forest.predict_proba_early_exit(row) >= 0.5;
+        if (full_side != early_side) proba_side_mismatches++;
+    }
+    TEST_CHECK(mismatches == 0);
+    TEST_CHECK(proba_side_mismatches == 0);
+    TEST_CHECK(stats.rows == data.size());
+    // most rows are far from the boundary, so the vote is settled before every tree is consulted
+    TEST_CHECK(stats.average_trees() < 15.0);
+}
+
+void test_forest_load_rejects_bad_tree_order(void) {
+    std::vector<std::vector<double>> data;
+    for (int i = 0; i < 60; i++) data.push_back({(double)(i % 7), (double)i, i % 3 == 0 ? 1.0 : 0.0});
+    RandomForest forest(3);
+    forest.train(data);
+    forest.order_trees_by_accuracy(data);
+    std::stringstream file;
+    forest.save(file);
+    std::string model = file.str();
+    size_t order_start = model.find("order");
+    std::string before = model.substr(0, order_start), after = model.substr(model.find('\n', order_start));
+    RandomForest loaded(0);
+    std::stringstream good(before + "order 2 0 1" + after);
+    loaded.load(good);
+    TEST_CHECK(loaded.predict_early_exit(data[0]) == loaded.predict(data[0]));
+    // an index past the trees or a repeated one would send the early-exit predictors out of bounds
+    for (const char* order : {"order 0 1 3", "order 0 1 1", "order 0 1"}) {
+        std::stringstream bad(before + order + after);
+        TEST_EXCEPTION(loaded.load(bad), std::runtime_error);
+    }
+}
+
+void test_quick_scorer_matches_traversal(void) {
+    std::vector<std::vector<double>> data = random_rows(5, 500, 3, [](const std::vector<double>& x, auto& uniform) {
+        return uniform() < x[0] * x[1] + 0.2 * x[2];
+    });
+    RandomForest forest(9);
+    forest.train(data);
+    std::vector<int> labels;
+    std::vector<RandomForest::ForestScore> scores;
+    for (const auto& row : data) {
+        labels.push_back(forest.predict(row));
+        scores.push_back(forest.score(row));
+    }
+    // noisy labels grow trees with far more than 64 leaves, so masks span several words
+    forest.set_inference_backend(RandomForest::QuickScorerBackend);
+    int mismatches = 0;
+    for (size_t i = 0; i < data.size(); i++) {
+        RandomForest::ForestScore score = forest.score(data[i]);
+        if (forest.predict(data[i]) != labels[i] || score.vote_fraction != scores[i].vote_fraction
+            || score.leaf_frequency != scores[i].leaf_frequency) mismatches++;
+    }
+    TEST_CHECK(mismatches == 0);
+}
+
+void test_compiled_forest_matches_traversal(void) {
+    std::vector<std::vector<double>> data = random_rows(9, 300, 2, [](const std::vector<double>& x, auto& uniform) { return uniform() < x[0] * x[1] + 0.2; });
+    RandomForest forest(5);
+    forest.train(data);
+    // a quote in the paths must reach the compiler and dlopen intact
+    std::string source = "test_compiled_forest's.cpp", library = "./test_compiled_forest's.so";
+    ForestCodeGenerator::generate(forest, source);
+    try {
+        ForestCodeGenerator::compile(source, library, "", "-O0");
+    } catch (const std::exception& e) {
+        std::remove(source.c_str());
+        TEST_SKIP("%s", e.what());
+        return;
+    }
+    CompiledForest compiled(library);
+    TEST_CHECK(compiled.num_trees() == 5);
+    int mismatches = 0;
+    for (const auto& row : data) {
+        RandomForest::ForestScore expected = forest.score(row), actual = compiled.score(row);
+        if (expected.vote_fraction != actual.vote_fraction || expected.leaf_frequency != actual.leaf_frequency) mismatches++;
+    }
+    TEST_CHECK(mismatches == 0);
+    std::remove(source.c_str());
+    std::remove(library.c_str());
+}
+
+void test_compiled_forest_handles_deep_trees(void) {
+    // a chain of 1000 splits, each peeling one value off to a leaf, written in the model file format
+    const int depth = 1000;
+    std::string model = "RandomForest 1 1\n";
+    for (int k = 0; k < depth; k++) model += "S 0 " + std::to_string(k) + ".5\nL " + std::to_string(k % 2) + " " + std::to_string(k % 2) + "\n";
+    model += "L 1 0.25\nend\n";
+    std::stringstream file(model);
+    RandomForest forest(0);
+    forest.load(file);
+
+    // nesting must not grow with the depth, or compilers reject the source
+    std::stringstream source_text;
+    ForestCodeGenerator::generate(forest.get_trees(), source_text);
+    int open = 0, deepest = 0;
+    for (char c : source_text.str()) {
+        if (c == '{') deepest = std::max(deepest, ++open);
+        else if (c == '}') open--;
+    }
+    TEST_CHECK(deepest <= 2);
+
+    std::string source = "test_compiled_deep.cpp", library = "./test_compiled_deep.so";
+    ForestCodeGenerator::generate(forest, source);
+    try {
+        ForestCodeGenerator::compile(source, library, "", "-O0");
+    } catch (const std::exception& e) {
+        std::remove(source.c_str());
+        TEST_SKIP("%s", e.what());
+        return;
+    }
+    CompiledForest compiled(library);
+    int mismatches = 0;
+    for (int k = 0; k <= depth; k++) {
+        std::vector<double> row = {(double)k};
+        if (compiled.score(row).leaf_frequency != forest.score(row).leaf_frequency) mismatches++;
+    }
+    TEST_CHECK(mismatches == 0);
+    std::remove(source.c_str());
+    std::remove(library.c_str());
+}
+
+void test_flat_forest_kernels_match_traversal(void) {
+    std::vector<std::vector<double>> data = random_rows(11, 403, 3, [](const std::vector<double>& x, auto& uniform) {
+        return uniform() < x[0] * x[1] + 0.2 * x[2];
+    });
+    data[7][1] = NAN;   // NaN goes right in every kernel
+    RandomForest forest(7);
+    forest.train(data);
+    std::vector<RandomForest::ForestScore> expected;
+    forest.score_batch(data, expected);
+    FlatForest flat(forest.get_trees());
+    std::vector<FlatForest::SimdLevel> levels = {FlatForest::Scalar};
+    if (FlatForest::detect() >= FlatForest::AVX2) levels.push_back(FlatForest::AVX2);
+    if (FlatForest::detect() >= FlatForest::AVX512) levels.push_back(FlatForest::AVX512);
+    for (FlatForest::SimdLevel level : levels) {
+        std::vector<int> votes(data.size());
+        std::vector<double> sums(data.size());
+        flat.score_rows(data, 0, data.size(), votes.data(), sums.data(), level);
+        int mismatches = 0;
+        for (size_t i = 0; i < data.size(); i++) {
+            if (votes[i] / 7.0 != expected[i].vote_fraction || sums[i] / 7 != expected[i].leaf_frequency) mismatches++;
+        }
+        TEST_CHECK_(mismatches == 0, "level %d: %d mismatches", (int)level, mismatches);
+    }
+    forest.set_inference_backend(RandomForest::SimdBackend);
+    std::vector<double> proba;
+    forest.predict_proba_batch(data, proba);
+    TEST_CHECK(proba[7] == expected[7].leaf_frequency && proba[402] == expected[402].leaf_frequency);
+}
+
+void test_quantized_forest_matches_traversal(void) {
+    std::vector<std::vector<double>> data = random_rows(13, 300, 2, [](const std::vector<double>& x, auto& uniform) { return uniform() < x[0] * x[1] + 0.2; });
+    std::vector<std::vector<double>> probes = random_rows(14, 300, 2, [](const std::vector<double>&, auto&) { return false; });
+    probes.push_back({NAN, 0.5, 0.0});
+    RandomForest forest(5);
+    forest.train(data);
+    // thresholds are exact on any input, so probe unseen values as well as the training rows
+    probes.insert(probes.end(), data.begin(), data.end());
+    std::vector<RandomForest::ForestScore> expected;
+    forest.score_batch(probes, expected);
+    forest.set_inference_backend(RandomForest::QuantizedBackend);
+    int mismatches = 0;
+    for (size_t i = 0; i < probes.size(); i++) {
+        RandomForest::ForestScore score = forest.score(probes[i]);
+        if (score.vote_fraction != expected[i].vote_fraction || score.leaf_frequency != expected[i].leaf_frequency) mismatches++;
+    }
+    TEST_CHECK(mismatches == 0);
+    QuantizedForest quantized(forest.get_trees());
+    TEST_CHECK(quantized.wide_bins() == (quantized.get_threshold_table().max_thresholds() > 255));
+    TEST_CHECK(quantized.node_gini(0) == forest.get_trees()[0].get_root()->gini_index);
+    // breadth first, so node 1 is the root's left child
+    TEST_CHECK(quantized.node_gini(1) == forest.get_trees()[0].get_root()->left->gini_index);
+}
+
+void test_node_arena_releases_tree(void) {
+    NodeArena arena;
+    {
+        NodePtr root(arena.create());
+        root->left.reset(arena.create());
+        root->right.reset(arena.create());
+        for (int i = 0; i < 5000; i++) arena.create();
+    }
+    TEST_CHECK(arena.node_count() == 5003);
+    TEST_CHECK(arena.bytes_reserved() >= 5003 * sizeof(Node));
+    arena.clear();
+    TEST_CHECK(arena.node_count() == 0 && arena.bytes_reserved() == 0);
+
+    std::vector<std::vector<double>> data = {{1, 0}, {2, 0}, {3, 1}, {4, 1}, {5, 0}, {6, 1}};
+    TreeOptions options;
+    options.huge_pages = true;
+    std::vector<DecisionTree> trees(2);
+    trees[0] = DecisionTree(options);
+    trees[0].train(data);
+    TEST_CHECK(trees[0].arena_bytes() > 0);
+    trees[1] = std::move(trees[0]);             // the old tree of trees[1] is released before its arena
+    TEST_CHECK(trees[1].predict({3}) == 1 && trees[1].predict({5}) == 0);
+    trees[1].train(data);                       // retraining swaps in a fresh arena
+    TEST_CHECK(trees[1].predict({6}) == 1);
+}
+
+void test_hoeffding_tree_stream(void) {
+    HoeffdingTree tree(1e-5, 100);
+    mt19937 rng(42);
+    uniform_real_distribution<double> dist(0.0, 1.0);
+    for (int i = 0; i < 5000; i++) {
+        double x0 = dist(rng), x1 = dist(rng);
+        tree.update({x0, x1}, x0 < 0.5 ? 0 : 1);
+    }
+    TEST_CHECK(tree.get_rows_seen() == 5000);
+    TEST_CHECK(tree.predict({0.1, 0.5}) == 0);
+    TEST_CHECK(tree.predict({0.9, 0.5}) == 1);
+}
+
+void test_hoeffding_tree_train_ignores_label(void) {
+    // noisy labels: a tree that saw the label as a feature would split on it
+    HoeffdingTree tree(1e-5, 100);
+    std::vector<std::vector<double>> data = random_rows(8, 20000, 2, [](const std::vector<double>& x, auto& uniform) {
+        bool label = x[0] >= 0.5;
+        return uniform() < 0.3 ? !label : label;
+    });
+    tree.train(data);
+    TEST_CHECK(max_split_feature(tree.get_root()) < 2);
+    TEST_CHECK(tree.predict({0.1, 0.5}) == 0);
+    TEST_CHECK(tree.predict({0.9, 0.5}) == 1);
+}
+
+void test_synthetic_data_deterministic(void) {
+    std::stringstream csv;
+    csv << "purpose,rate,fico,label\n";
+    mt19937 rng(17);
+    uniform_real_distribution<double> dist(0.0, 1.0);
+    const char* purposes[] = {"car", "home", "other"};
+    for (int i = 0; i < 500; i++) {
+        double rate = 0.05 + 0.2 * dist(rng);
+        csv << purposes[i % 3] << "," << rate << "," << 600 + i % 200 << "," << (rate > 0.15 ? 1 : 0) << "\n";
+    }
+    DatasetProfile profile = DatasetProfile::learn(csv);
+    TEST_CHECK(profile.columns[0].categorical && !profile.columns[1].categorical && profile.class_values.size() == 2);
+    SyntheticGenerator generator(profile, 7);
+    std::ostringstream one, many;
+    generator.write(one, 1000, false, 64, 1);
+    generator.write(many, 1000, false, 64, 4);
+    TEST_CHECK(one.str() == many.str());
+
+    // the binary format reads back the same cells
+    std::stringstream binary;
+    generator.write(binary, 1000, true, 64, 2);
+    BinaryColumnReader reader(binary);
+    TEST_CHECK(reader.columns.size() == 4 && reader.columns[0].categories == profile.columns[0].categories);
+    ColumnBlock block, expected;
+    size_t rows = 0, index = 0;
+    bool same = true;
+    while (reader.next_block(block)) {
+        generator.generate_block(index++, block.rows, expected);
+        same = same && block.columns == expected.columns;
+        rows += block.rows;
+    }
+    TEST_CHECK(rows == 1000 && same);
+}
+
+void test_instrumentation_counts_training(void) {
+    Instrumentation& instrumentation = Instrumentation::global();
+    instrumentation.reset();
+    instrumentation.set_tracing(true);
+    std::vector<std::vector<double>> data;
+    for (int i = 0; i < 200; i++) data.push_back({(double)i, (double)(i % 7), i < 120 ? 0.0 : 1.0});
+    DecisionTree tree;
+    tree.train(data);
+    InstrumentationReport report = instrumentation.report();
+#ifndef LRP_DISABLE_INSTRUMENTATION
+    TEST_CHECK(report.counter(Instrumentation::TreesTrained) == 1);
+    TEST_CHECK(report.counter(Instrumentation::NodesBuilt) == 3);
+    TEST_CHECK(report.counter(Instrumentation::RowsPartitioned) == 200);
+    TEST_CHECK(report.counter(Instrumentation::BytesAllocated) == tree.arena_bytes());
+    TEST_CHECK(report.phase("tree.train").calls == 1 && report.phase("tree.train/evaluate_level").calls == 2);
+    std::ostringstream trace;
+    instrumentation.write_chrome_trace(trace);
+    TEST_CHECK(trace.str().find("\"name\":\"tree.train\",\"ph\":\"X\"") != std::string::npos);
+#endif
+    instrumentation.set_tracing(false);
+    instrumentation.reset();
+}
+
+void test_phase_cpu_time_is_the_phase_threads(void) {
+    Instrumentation& instrumentation = Instrumentation::global();
+    instrumentation.reset();
+    std::atomic<bool> stop(false);
+    std::thread busy([&stop] { while (!stop.load()) {} });   // CPU spent on another thread while the phase sleeps
+    {
+        ScopedPhase phase("sleeping");
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    stop = true;
+    busy.join();
+    PhaseStats stats = instrumentation.report().phase("sleeping");
+    TEST_CHECK(stats.calls == 1 && stats.wall_seconds >= 0.1);
+    TEST_CHECK_(stats.cpu_seconds < 0.05, "sleeping phase was charged %f CPU seconds", stats.cpu_seconds);
+    instrumentation.reset();
+}
+
+void test_logger_rate_limits_and_counts(void) {
+    Logger& logger = Logger::global();
+    std::ostringstream console;
+    LogLevel previous = logger.level();
+    logger.set_console(&console);
+    logger.set_level(LogLevel::Info);
+    logger.set_rate_limit(5);
+    for (int i = 0; i < 100; i++) LRP_LOG_WARNING("test.repeated", "bad cell " << i);
+    LRP_LOG_DEBUG("test.hidden", "not written");
+    logger.flush();
+    std::string text = console.str();
+    // five lines, then the summary of the other 95 even though the event never fires again
+    TEST_CHECK(std::count(text.begin(), text.end(), '\n') == 6);
+    TEST_CHECK(text.find("WARN  [test.repeated] bad cell 4") != std::string::npos);
+    TEST_CHECK(text.find("WARN  [test.repeated] suppressed 95 similar lines") != std::string::npos);
+    TEST_CHECK(logger.event_count("test.repeated") == 100 && logger.event_count("test.hidden") == 1);
+    logger.set_rate_limit(10);
+    logger.set_level(previous);
+    logger.set_console(&std::clog);
+}
+
+void test_logger_forgets_destroyed_events(void) {
+    Logger& logger = Logger::global();
+    std::ostringstream console;
+    logger.set_console(&console);
+    logger.set_rate_limit(2);
+    {
+        // stands for a static LRP_LOG event destroyed at exit, before the logger
+        LogEvent event("test.short_lived");
+        for (int i = 0; i < 5; i++) event.occur(LogLevel::Warning);
+    }
+    TEST_CHECK(logger.event_counts().count("test.short_lived") == 0);
+    logger.flush();   // walks the events, which must no longer include the destroyed one
+    TEST_CHECK(console.str().find("WARN  [test.short_lived] suppressed 3 similar lines") != std::string::npos);
+    logger.set_rate_limit(10);
+    logger.set_console(&std::clog);
+}
+
+void test_row_encoder_schema_round_trip(void) {
+    // one-hot layout of process_data: purpose:car, purpose:home, rate, label
+    DataFrame frame({"purpose:car", "purpose:home", "rate", "label"}, {{1, 0, 0.1, 0}, {0, 1, 0.3, 1}}, {1, 0, 0.2, 0}, {{"purpose", {{"car", 0}, {"home", 1}}}});
+    RowEncoder built(frame);
+    std::stringstream schema;
+    built.save(schema);
+    RowEncoder encoder = RowEncoder::load(schema);
+    TEST_CHECK(encoder.num_features() == 3 && encoder.get_columns().size() == 2);
+    // columns are matched by name, unknown ones are ignored and missing cells imputed
+    encoder.bind({"rate", "extra", "purpose"});
+    std::vector<double> row(3);
+    encoder.encode({"0.25", "x", "home"}, row.data());
+    TEST_CHECK(row == std::vector<double>({0, 1, 0.25}));
+    encoder.encode({"", "x", "boat"}, row.data());
+    TEST_CHECK(row == std::vector<double>({1, 0, 0.2}));
+}
+
+void test_suggestion_returns_closest_positive_row(void) {
+    // purpose:car, purpose:home, two numerical columns, label (0 = paid back)
+    DataFrame frame({"purpose:car", "purpose:home", "a", "b", "label"},
+                    {{1, 0, 1, 1, 0}, {1, 0, 3, 1, 0}, {1, 0, 1, 3, 0}, {0, 1, 1, 3, 0}, {1, 0, 1, 3, 1}},
+                    {0, 0, 1, 1, 0}, {{"purpose", {{"car", 0}, {"home", 1}}}});
+    SuggestionGenerator generator;
+    // row 2 matches exactly; row 3 is another purpose and row 4 was not paid back
+    std::vector<double> point = {1, 0, 1, 3, 0};
+    TEST_CHECK(generator.get_closest_positive_row(point, &frame) == 2);
+    TEST_CHECK(generator.get_closest_positive_prediction(point, &frame) == frame.get_data_vec()[2]);
+    point = {1, 0, 2.5, 1, 0};
+    TEST_CHECK(generator.get_closest_positive_row(point, &frame) == 1);
+    // no paid back loan has this purpose
+    TEST_CHECK(generator.get_closest_positive_row({0, 0, 1, 1, 0}, &frame) == -1);
+    TEST_CHECK(generator.get_closest_positive_prediction({0, 0, 1, 1, 0}, &frame).empty());
+}
+
+void test_random_forest_seed_is_reproducible(void) {
+    std::vector<std::vector<double>> data;
+    for (int i = 0; i < 300; i++) data.push_back({(double)(i % 17), (double)((i * 7) % 11), (i % 17) + ((i * 7) % 11) > 14 ? 1.0 : 0.0});
+    std::string models[2];
+    for (int run = 0; run < 2; run++) {
+        TreeOptions options = RandomForest::default_tree_options();
+        options.num_threads = run == 0 ? 1 : 4;
+        RandomForest forest(8, options);
+        forest.set_seed(11);
+        forest.train(data);
+        std::ostringstream out;
+        forest.save(out);
+        models[run] = out.str();
+    }
+    // same seed, same model, whatever the thread count
+    TEST_CHECK(!models[0].empty() && models[0] == models[1]);
+}
+
+void test_micro_batcher_coalesces_requests(void) {
+    std::atomic<int> calls(0);
+    MicroBatcher<double> batcher([&](const std::vector<std::vector<double>>& rows, std::vector<double>& out) {
+        calls++;
+        for (const auto& row : rows) if (row[0] < 0) throw std::runtime_error("negative");
+        out.resize(rows.size());
+        for (size_t i = 0; i < rows.size(); i++) out[i] = rows[i][0] * 2;
+    }, 16, std::chrono::microseconds(2000));
+    std::vector<std::thread> clients;
+    std::atomic<int> wrong(0);
+    for (int c = 0; c < 8; c++) {
+        clients.emplace_back([&, c] {
+            for (int i = 0; i < 50; i++) if (batcher.submit({(double)(c * 100 + i)}) != 2.0 * (c * 100 + i)) wrong++;
+        });
+    }
+    for (auto& client : clients) client.join();
+    TEST_CHECK(wrong == 0 && batcher.row_count() == 400);
+    // the 2 ms window lets concurrent requests share batches
+    TEST_CHECK(batcher.batch_count() < 400 && batcher.largest_batch() > 1 && batcher.largest_batch() <= 16);
+    bool thrown = false;
+    try { batcher.submit({-1.0}); } catch (const std::runtime_error&) { thrown = true; }
+    TEST_CHECK(thrown);
+
+    LatencyRecorder latencies(100);
+    for (int i = 1; i <= 200; i++) latencies.record(std::chrono::microseconds(i));
+    // only the last 100 latencies, 101 to 200 us, count for percentiles
+    TEST_CHECK(latencies.count() == 200 && std::fabs(latencies.percentile(50) - 150) <= 1 && std::fabs(latencies.percentile(99) - 199) <= 1);
+    TEST_CHECK(std::fabs(latencies.max() - 200) < 1e-6 && std::fabs(latencies.mean() - 100.5) < 1e-6);
+}
+
+void test_histogram_split_matches_exact_on_few_values(void) {
+    // with fewer distinct values than bins every cut is a distinct value, so histogram splits are the exact ones
+    std::vector<std::vector<double>> data;
+    for (int i = 0; i < 400; i++) data.push_back({(double)(i % 13), (double)((i * 7) % 5), (double)((i * 3) % 11), (i % 13) + ((i * 3) % 11) > 12 ? 1.0 : 0.0});
+    TreeOptions exact_options;
+    TreeOptions histogram_options;
+    histogram_options.max_bins = 256;
+    DecisionTree exact(exact_options), histogram(histogram_options);
+    exact.train(data);
+    histogram.train(data);
+    std::ostringstream exact_model, histogram_model;
+    exact.save(exact_model);
+    histogram.save(histogram_model);
+    TEST_CHECK(exact_model.str() == histogram_model.str());
+}
+
+void test_hyperparameter_search_grid(void) {
+    std::vector<std::vector<double>> data;
+    for (int i = 0; i < 300; i++) data.push_back({(double)(i % 17), (double)((i * 7) % 11), (i % 17) + ((i * 7) % 11) > 14 ? 1.0 : 0.0});
+    SearchSpace space;
+    space.num_trees = {3, 6};
+    space.max_depth = {2, -1};
+    space.max_bins = {0, 32};
+    std::vector<SearchTrial> trials = space.grid();
+    TEST_CHECK(trials.size() == 8 && space.grid_size() == 8);
+    std::mt19937 rng(3);
+    TEST_CHECK(space.sample(5, rng).size() == 5);
+    HyperparameterSearch first(data, 3, 11), second(data, 3, 11);
+    std::vector<TrialResult> a = first.run(trials), b = second.run(trials, 1);
+    bool same = a.size() == trials.size();
+    for (size_t t = 0; same && t < a.size(); t++) same = a[t].accuracy == b[t].accuracy && a[t].accuracy_stddev == b[t].accuracy_stddev;
+    TEST_CHECK(same);
+    // the deep forests separate this boundary well
+    TEST_CHECK(a[7].trial.num_trees == 6 && a[7].trial.options.max_depth == -1 && a[7].accuracy > 0.9);
+    std::ostringstream table;
+    HyperparameterSearch::write_table(table, a);
+    std::string text = table.str();
+    TEST_CHECK(std::count(text.begin(), text.end(), '\n') == 9);
+}
+
+void test_binned_matrix_cuts_on_given_rows(void) {
+    // the held-out rows (odd values) must not become cuts, but are still binned
+    std::vector<std::vector<double>> data;
+    std::vector<std::vector<double>> train;
+    std::vector<size_t> even;
+    for (int i = 0; i < 40; i++) {
+        data.push_back({(double)i, 0.0});
+        if (i % 2 == 0) {
+            even.push_back(i);
+            train.push_back(data.back());
+        }
+    }
+    BinnedMatrix cut_on_even(data, 1, 256, 1, &even), expected(train, 1, 256, 1);
+    TEST_CHECK(cut_on_even.cuts(0) == expected.cuts(0));
+    TEST_CHECK(cut_on_even.num_rows() == 40 && cut_on_even.column(0)[3] == expected.bin_of(0, 3.0));
+}
+
+void test_feature_importance_finds_signal(void) {
+    // only feature 1 decides the label; features 0 and 2 are noise
+    std::vector<std::vector<double>> train = random_rows(17, 600, 3, [](const std::vector<double>& x, auto&) { return x[1] > 0.5; });
+    std::vector<std::vector<double>> test(train.begin() + 400, train.end());
+    train.resize(400);
+    RandomForest forest(10);
+    forest.set_seed(4);
+    forest.train(train);
+    std::vector<double> impurity = forest.impurity_importance();
+    TEST_CHECK(impurity.size() == 3);
+    TEST_CHECK(impurity[1] > impurity[0] && impurity[1] > impurity[2]);
+    TEST_CHECK(std::fabs(impurity[0] + impurity[1] + impurity[2] - 1.0) < 1e-9);
+
+    forest.set_inference_backend(RandomForest::SimdBackend);
+    // substituting the column's own values scores like the plain batch
+    std::vector<double> column;
+    for (const auto& row : test) column.push_back(row[1]);
+    std::vector<RandomForest::ForestScore> plain, substituted;
+    forest.score_batch(test, plain);
+    forest.score_batch_with_column(test, 1, column, substituted);
+    bool same = plain.size() == substituted.size();
+    for (size_t i = 0; same && i < plain.size(); i++) same = plain[i].vote_fraction == substituted[i].vote_fraction;
+    TEST_CHECK(same);
+    // the traversal backend substitutes into a reused scratch row and must agree with the flat blocks
+    std::reverse(column.begin(), column.end());
+    std::vector<RandomForest::ForestScore> flat, traversal;
+    forest.score_batch_with_column(test, 1, column, flat);
+    forest.set_inference_backend(RandomForest::TraversalBackend);
+    forest.score_batch_with_column(test, 1, column, traversal);
+    same = flat.size() == traversal.size();
+    for (size_t i = 0; same && i < flat.size(); i++) same = flat[i].vote_fraction == traversal[i].vote_fraction && flat[i].leaf_frequency == traversal[i].leaf_frequency;
+    TEST_CHECK(same);
+    forest.set_inference_backend(RandomForest::SimdBackend);
+
+    PermutationImportance a = permutation_importance(forest, test, 3, 9), b = permutation_importance(forest, test, 3, 9, 1);
+    TEST_CHECK(a.baseline_accuracy > 0.9);
+    TEST_CHECK(a.accuracy_decrease[1] > 0.3 && a.accuracy_decrease[1] > a.accuracy_decrease[0] && a.accuracy_decrease[1] > a.accuracy_decrease[2]);
+    TEST_CHECK(a.brier_increase[1] > a.brier_increase[0] && a.brier_increase[1] > a.brier_increase[2]);
+    TEST_CHECK(a.brier_increase == b.brier_increase);
+}
+
+void test_metrics_match_brute_force(void) {
+    // coarse probabilities so that many rows tie
+    std::mt19937 rng(23);
+    std::uniform_int_distribution<int> level(0, 10);
+    std::vector<double> probabilities;
+    std::vector<int> labels;
+    for (int i = 0; i < 400; i++) {
+        double p = level(rng) / 10.0;
+        probabilities.push_back(p);
+        labels.push_back(std::uniform_real_distribution<double>(0.0, 1.0)(rng) < p * 0.8 + 0.1 ? 1 : 0);
+    }
+    EvaluationReport report = evaluate_probabilities(probabilities, labels, 0.5, 4);
+    double pairs = 0, wins = 0, brier = 0;
+    for (size_t i = 0; i < labels.size(); i++) {
+        brier += (probabilities[i] - labels[i]) * (probabilities[i] - labels[i]) / labels.size();
+        for (size_t j = 0; j < labels.size(); j++) {
+            if (labels[i] != 1 || labels[j] != 0) continue;
+            pairs++;
+            wins += probabilities[i] > probabilities[j] ? 1.0 : probabilities[i] == probabilities[j] ? 0.5 : 0.0;
+        }
+    }
+    TEST_CHECK(std::fabs(report.roc_auc - wins / pairs) < 1e-12);
+    TEST_CHECK(std::fabs(report.brier - brier) < 1e-12);
+    TEST_CHECK(report.curve.size() == 11);
+    TEST_CHECK(report.pr_auc > 0 && report.pr_auc <= 1 && report.log_loss > 0);
+    for (double threshold : {-1.0, 0.0, 0.35, 0.5, 0.7, 1.0}) {
+        ConfusionMatrix direct, looked_up = report.at_threshold(threshold);
+        for (size_t i = 0; i < labels.size(); i++) {
+            bool positive = probabilities[i] > threshold;
+            if (labels[i] == 1) (positive ? direct.true_positives : direct.false_negatives)++;
+            else (positive ? direct.false_positives : direct.true_negatives)++;
+        }
+        TEST_CHECK(looked_up.true_positives == direct.true_positives && looked_up.false_positives == direct.false_positives);
+        TEST_CHECK(looked_up.true_negatives == direct.true_negatives && looked_up.false_negatives == direct.false_negatives);
+    }
+    size_t binned = 0;
+    for (const CalibrationBin& bin : report.calibration) binned += bin.count;
+    TEST_CHECK(report.calibration.size() == 4 && binned == labels.size());
+
+    // the forest's hard predictions agree with evaluate_accuracy
+    std::vector<std::vector<double>> data;
+    for (int i = 0; i < 300; i++) data.push_back({(double)(i % 13), (double)((i * 5) % 7), (i % 13) + ((i * 5) % 7) > 9 ? 1.0 : 0.0});
+    RandomForest forest(7);
+    forest.set_seed(2);
+    forest.train(data);
+    RandomForest::AccuracyMetrics accuracy = forest.evaluate_accuracy(data);
+    ConfusionMatrix votes = evaluate_forest(forest, data).predicted;
+    TEST_CHECK((int)votes.true_positives == accuracy.true_positives && (int)votes.true_negatives == accuracy.true_negatives);
+    TEST_CHECK((int)votes.false_positives == accuracy.false_positives && (int)votes.false_negatives == accuracy.false_negatives);
+}
 
 TEST_LIST = {
     {"test_split_basic", test_split_basic},
@@ -80,5 +942,42 @@ TEST_LIST = {
     {"test_split_not_possible", test_split_not_possible},
     { "best_split", test_best_split },
     { "test_calculate_gini_index", test_calculate_gini_index },
+    { "test_max_depth_limits_tree", test_max_depth_limits_tree },
+    { "test_tree_never_splits_on_label", test_tree_never_splits_on_label },
+    { "test_min_samples_leaf", test_min_samples_leaf },
+    { "test_thread_pool_nested_parallel_for", test_thread_pool_nested_parallel_for },
+    { "test_thread_pool_rethrows_on_caller", test_thread_pool_rethrows_on_caller },
+    { "test_feature_parallel_split_matches_serial", test_feature_parallel_split_matches_serial },
+    { "test_max_features_resolve", test_max_features_resolve },
+    { "test_random_split_tree", test_random_split_tree },
+    { "test_extra_trees_skip_bootstrap_and_split_randomly", test_extra_trees_skip_bootstrap_and_split_randomly },
+    { "test_gradient_boosting_learns_boundary", test_gradient_boosting_learns_boundary },
+    { "test_random_forest_save_load", test_random_forest_save_load },
+    { "test_forest_rejects_rows_short_of_its_features", test_forest_rejects_rows_short_of_its_features },
+    { "test_random_forest_probabilities", test_random_forest_probabilities },
+    { "test_early_exit_matches_full_vote", test_early_exit_matches_full_vote },
+    { "test_forest_load_rejects_bad_tree_order", test_forest_load_rejects_bad_tree_order },
+    { "test_quick_scorer_matches_traversal", test_quick_scorer_matches_traversal },
+    { "test_compiled_forest_matches_traversal", test_compiled_forest_matches_traversal },
+    { "test_compiled_forest_handles_deep_trees", test_compiled_forest_handles_deep_trees },
+    { "test_flat_forest_kernels_match_traversal", test_flat_forest_kernels_match_traversal },
+    { "test_quantized_forest_matches_traversal", test_quantized_forest_matches_traversal },
+    { "test_node_arena_releases_tree", test_node_arena_releases_tree },
+    { "test_hoeffding_tree_stream", test_hoeffding_tree_stream },
+    { "test_hoeffding_tree_train_ignores_label", test_hoeffding_tree_train_ignores_label },
+    { "test_synthetic_data_deterministic", test_synthetic_data_deterministic },
+    { "test_instrumentation_counts_training", test_instrumentation_counts_training },
+    { "test_phase_cpu_time_is_the_phase_threads", test_phase_cpu_time_is_the_phase_threads },
+    { "test_logger_rate_limits_and_counts", test_logger_rate_limits_and_counts },
+    { "test_logger_forgets_destroyed_events", test_logger_forgets_destroyed_events },
+    { "test_row_encoder_schema_round_trip", test_row_encoder_schema_round_trip },
+    { "test_suggestion_returns_closest_positive_row", test_suggestion_returns_closest_positive_row },
+    { "test_random_forest_seed_is_reproducible", test_random_forest_seed_is_reproducible },
+    { "test_micro_batcher_coalesces_requests", test_micro_batcher_coalesces_requests },
+    { "test_histogram_split_matches_exact_on_few_values", test_histogram_split_matches_exact_on_few_values },
+    { "test_hyperparameter_search_grid", test_hyperparameter_search_grid },
+    { "test_binned_matrix_cuts_on_given_rows", test_binned_matrix_cuts_on_given_rows },
+    { "test_feature_importance_finds_signal", test_feature_importance_finds_signal },
+    { "test_metrics_match_brute_force", test_metrics_match_brute_force },
     { NULL, NULL }  // Terminate the list
 };
\ No newline at end of file
@@ -11,9 +11,11 @@
 #define DATAHANDLER_H
 
 #include "../Includes/DataFrame.h"
+#include "../Includes/Logger.h"
 
 #include <iostream>
 #include <fstream>
+#include <iterator>
 #include <vector>
 #include <sstream>
 #include <string>
@@ -277,16 +279,14 @@ class DataHandler {
 
             double total_count = string_count + integer_count;
             if((integer_count > 0) && (double)integer_count/total_count < .05) {
-                std::cout << "Disparity found: " << data_vec[0][col] << std::endl;
-                std::cout << "integer_count: " << integer_count << " / total_count: " << total_count << " = " << (double)integer_count/total_count << std::endl;
+                LRP_LOG_WARNING("data.disparity", "Disparity found in " << data_vec[0][col] << ": integer_count " << integer_count << " / total_count " << total_count << " = " << (double)integer_count/total_count);
                 for(int val : integer_index_vector) {
                     if(data_vec[val][col] == "NULL") continue;
                     vector_drop_row(data_vec, val);
                 }
             }
             if((string_count > 0) && (double)string_count/total_count < .05) {
-                std::cout << "Disparity found: " << data_vec[0][col] << std::endl;
-                std::cout << "string_count: " << string_count << " / total_count: " << total_count << " = " << (double)string_count/total_count << std::endl;
+                LRP_LOG_WARNING("data.disparity", "Disparity found in " << data_vec[0][col] << ": string_count " << string_count << " / total_count " << total_count << " = " << (double)string_count/total_count);
                 for(int val : string_index_vector) {
                     if(data_vec[val][col] == "NULL") continue;
                     vector_drop_row(data_vec, val);
@@ -312,7 +312,7 @@ class DataHandler {
                     doubleRow.push_back(val);
                 } catch(...) {
                     doubleRow.push_back(-1.0); //  if conversion failed, place -1 instead
-                    std::cout << "Conversion error: " << data_vec[row][col] << std::endl;
+                    LRP_LOG_WARNING("data.conversion_error", "Conversion error at row " << row << ", column " << col << ": " << data_vec[row][col]);
                 }
             }
             double_vec.push_back(doubleRow);
@@ -333,7 +333,7 @@ class DataHandler {
             } catch(...) {
                 // double_vec.push_back(0.0);
                 double_vec.push_back(df.get_impute_vec()[col]);
-                std::cout << "Conversion error: " << data_vec[col] << std::endl;
+                LRP_LOG_WARNING("data.conversion_error", "Conversion error at column " << col << ": " << data_vec[col]);
             }
         }
         return double_vec;
@@ -425,7 +425,6 @@ class DataHandler {
 
         // Iterate through the map to find the key with maximum occurrences
         for (const auto& pair : occurrence_map) {
-            std::cout << pair.first << std::endl;
             if (pair.second > max_occurrences) {
                 most_occurred_key = pair.first;
                 max_occurrences = pair.second;
@@ -0,0 +1,201 @@
+/**
+ * @file RowEncoder.h
+ * @brief A header that turns raw input rows into the one-hot encoded feature rows of a model trained on DataHandler::process_data output.
+ * @version 0.1
+ * @date 2024-06-12
+ */
+
+// Create header guard
+#ifndef ROWENCODER_H
+#define ROWENCODER_H
+
+#include "../Includes/DataFrame.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/// @brief Schema of a training DataFrame: which raw columns the model reads, how categorical columns are one-hot encoded and which values replace missing cells.
+/// Input columns are matched to the schema by header name, so scored files may order their columns freely, leave some out (they are imputed) or carry extra ones.
+/// The label, the last column of the DataFrame, is not part of the encoded row.
+class RowEncoder {
+public:
+    /// @brief A column of the raw data.
+    struct Column {
+        std::string name;
+        bool categorical = false;
+        /// @brief Output index of a numerical column.
+        int output = -1;
+        /// @brief Output index of every category of a categorical column.
+        std::unordered_map<std::string, int> categories;
+    };
+
+    RowEncoder() {}
+
+    /// @brief Builds the schema of a DataFrame made by DataHandler::process_data.
+    explicit RowEncoder(DataFrame& frame) {
+        const std::vector<std::string>& names = frame.get_feature_name_vec();
+        impute_values = frame.get_impute_vec();
+        impute_values.resize(names.size());
+        std::unordered_map<std::string, std::unordered_map<std::string, int>> groups = frame.get_categorical_groups();
+        std::unordered_map<int, std::string> group_of_output;
+        for(const auto& group : groups) {
+            for(const auto& category : group.second) group_of_output[category.second] = group.first;
+        }
+        // every output but the last (the label), in order; a categorical column appears where its first category is
+        for(size_t output = 0; output + 1 < names.size(); output++) {
+            auto group = group_of_output.find(static_cast<int>(output));
+            if(group == group_of_output.end()) {
+                Column column;
+                column.name = names[output];
+                column.output = static_cast<int>(output);
+                add_column(column);
+            } else if(column_index.find(group->second) == column_index.end()) {
+                Column column;
+                column.name = group->second;
+                column.categorical = true;
+                column.categories = groups[group->second];
+                add_column(column);
+            }
+        }
+        num_outputs = names.size() - 1;
+    }
+
+    /// @brief Writes the schema as text, read back by load.
+    void save(std::ostream& out) const {
+        out << "RowEncoder " << num_outputs << "\n" << std::setprecision(17) << "impute";
+        for(size_t output = 0; output < num_outputs; output++) out << " " << impute_values[output];
+        out << "\n";
+        for(const Column& column : columns) {
+            if(!column.categorical) {
+                out << "numeric " << column.output << " " << column.name << "\n";
+                continue;
+            }
+            out << "categorical " << column.categories.size() << " " << column.name << "\n";
+            // categories in output order, so the file does not depend on hash order
+            std::vector<std::pair<int, std::string>> ordered;
+            for(const auto& category : column.categories) ordered.push_back({category.second, category.first});
+            std::sort(ordered.begin(), ordered.end());
+            for(const auto& category : ordered) out << "category " << category.first << " " << category.second << "\n";
+        }
+        out << "end\n";
+    }
+
+    /// @throws std::runtime_error if the stream does not hold a schema written by save.
+    static RowEncoder load(std::istream& in) {
+        RowEncoder encoder;
+        std::string kind;
+        if(!(in >> kind >> encoder.num_outputs) || kind != "RowEncoder") throw std::runtime_error("Not a RowEncoder schema.");
+        if(!(in >> kind) || kind != "impute") throw std::runtime_error("RowEncoder schema is missing its impute values.");
+        encoder.impute_values.resize(encoder.num_outputs);
+        for(double& value : encoder.impute_values) {
+            if(!(in >> value)) throw std::runtime_error("RowEncoder schema has too few impute values.");
+        }
+        while(in >> kind && kind != "end") {
+            Column column;
+            size_t count = 0;
+            if(kind == "numeric") in >> column.output;
+            else if(kind == "categorical") {
+                column.categorical = true;
+                in >> count;
+            } else throw std::runtime_error("Unknown RowEncoder schema entry: " + kind);
+            in >> std::ws;
+            std::getline(in, column.name);
+            for(size_t i = 0; i < count; i++) {
+                int output;
+                std::string name;
+                if(!(in >> kind >> output) || kind != "category") throw std::runtime_error("RowEncoder schema has too few categories.");
+                in >> std::ws;
+                std::getline(in, name);
+                column.categories[name] = output;
+            }
+            if(!in) throw std::runtime_error("Truncated RowEncoder schema.");
+            encoder.add_column(column);
+        }
+        if(kind != "end") throw std::runtime_error("Truncated RowEncoder schema.");
+        return encoder;
+    }
+
+    /// @return Values in an encoded row, the feature count of the model.
+    size_t num_features() const { return num_outputs; }
+
+    const std::vector<Column>& get_columns() const { return columns; }
+
+    /// @return Index of the raw column named @p name, -1 if the schema has none.
+    int find_column(const std::string& name) const {
+        auto it = column_index.find(name);
+        return it == column_index.end() ? -1 : static_cast<int>(it->second);
+    }
+
+    /// @brief Matches the columns of an input file to the schema by name. Must be called before encode.
+    void bind(const std::vector<std::string>& header) {
+        input_columns.clear();
+        for(const std::string& name : header) input_columns.push_back(find_column(name));
+    }
+
+    /// @brief Encodes one row of cells in the order of the header passed to bind. Empty or unparseable cells and unknown categories are imputed.
+    /// @param out Receives num_features() values.
+    void encode(const std::vector<std::string>& cells, double* out) const {
+        reset(out);
+        for(size_t input = 0; input < cells.size() && input < input_columns.size(); input++) {
+            if(input_columns[input] < 0) continue;
+            const Column& column = columns[input_columns[input]];
+            if(column.categorical) {
+                auto category = column.categories.find(cells[input]);
+                if(category != column.categories.end()) set_category(column, category->second, out);
+            } else {
+                set_numeric(column, parse(cells[input]), out);
+            }
+        }
+    }
+
+    /// @brief Fills @p out with the impute values, the encoding of a row with every cell missing.
+    void reset(double* out) const {
+        std::copy(impute_values.begin(), impute_values.begin() + num_outputs, out);
+    }
+
+    /// @brief Stores a numerical value, NaN meaning missing.
+    void set_numeric(const Column& column, double value, double* out) const {
+        if(!std::isnan(value)) out[column.output] = value;
+    }
+
+    /// @brief Sets the one-hot columns of a categorical column to category output @p output, -1 leaving the imputed category.
+    void set_category(const Column& column, int output, double* out) const {
+        if(output < 0) return;
+        for(const auto& category : column.categories) out[category.second] = 0.0;
+        out[output] = 1.0;
+    }
+
+    /// @return The number in @p cell, NaN if it is empty or not a number.
+    static double parse(const std::string& cell) {
+        if(cell.empty()) return std::numeric_limits<double>::quiet_NaN();
+        char* end = nullptr;
+        double value = std::strtod(cell.c_str(), &end);
+        while(end && (*end == '\r' || *end == ' ')) end++;
+        return end == cell.c_str() || *end != '\0' ? std::numeric_limits<double>::quiet_NaN() : value;
+    }
+
+private:
+    void add_column(const Column& column) {
+        column_index[column.name] = columns.size();
+        columns.push_back(column);
+    }
+
+    std::vector<Column> columns;
+    std::unordered_map<std::string, size_t> column_index;
+    std::vector<double> impute_values;
+    size_t num_outputs = 0;
+    /// @brief Raw column of every input column, -1 for columns the model does not read.
+    std::vector<int> input_columns;
+};
+
+#endif // ROWENCODER_H
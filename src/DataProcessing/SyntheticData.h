@@ -0,0 +1,481 @@
+/**
+ * @file SyntheticData.h
+ * @brief A header that learns the column distributions of a CSV dataset and generates synthetic datasets of any size from them, as CSV or as blocked binary columns.
+ * @version 0.1
+ * @date 2024-06-09
+ */
+
+// Create header guard
+#ifndef SYNTHETICDATA_H
+#define SYNTHETICDATA_H
+
+#include "../Includes/ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <map>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/// @brief Learned distribution of one column, conditioned on the label class.
+struct ColumnProfile {
+    std::string name;
+    /// @brief Columns with text values or at most DatasetProfile::kMaxDiscreteValues distinct values are sampled from their value frequencies, others from quantiles.
+    bool categorical = false;
+    /// @brief Categorical values, in order of first appearance.
+    std::vector<std::string> categories;
+    /// @brief Per class: cumulative frequency of every category.
+    std::vector<std::vector<double>> cumulative;
+    /// @brief Per class: kQuantiles + 1 evenly spaced quantiles of a numeric column, interpolated when sampling.
+    std::vector<std::vector<double>> quantiles;
+    /// @brief Digits after the decimal point in the source, so generated values look like the source (fico stays an integer).
+    int decimals = 0;
+    /// @brief Per class: share of empty cells.
+    std::vector<double> missing_rate;
+};
+
+/// @brief Marginal distribution of every column of a dataset, conditioned on the label so that a model trained on generated data still has signal to find.
+class DatasetProfile {
+public:
+    static const size_t kQuantiles = 256;
+    static const size_t kMaxDiscreteValues = 32;
+
+    /// @brief Learns the profile of a CSV with a header row.
+    /// @param csv Stream holding the CSV. Cells are separated by commas and may be empty (missing).
+    /// @param label_column Column the others are conditioned on, -1 for the last column. It must be discrete.
+    static DatasetProfile learn(std::istream& csv, int label_column = -1) {
+        std::string line;
+        if(!std::getline(csv, line)) throw std::runtime_error("Empty CSV.");
+        DatasetProfile profile;
+        for(const std::string& name : split(line)) {
+            ColumnProfile column;
+            column.name = name;
+            profile.columns.push_back(column);
+        }
+        size_t num_columns = profile.columns.size();
+        std::vector<std::vector<std::string>> cells(num_columns);
+        while(std::getline(csv, line)) {
+            if(!line.empty() && line.back() == '\r') line.pop_back();
+            if(line.empty()) continue;
+            std::vector<std::string> row = split(line);
+            row.resize(num_columns);
+            for(size_t col = 0; col < num_columns; col++) cells[col].push_back(row[col]);
+        }
+        if(cells[0].empty()) throw std::runtime_error("CSV has no rows.");
+        profile.label_column = label_column < 0 ? num_columns - 1 : label_column;
+        if(profile.label_column >= num_columns) throw std::invalid_argument("Label column out of range.");
+
+        // classes are the distinct values of the label column
+        std::map<std::string, size_t> class_index;
+        std::vector<size_t> row_class(cells[0].size());
+        for(size_t row = 0; row < row_class.size(); row++) {
+            const std::string& value = cells[profile.label_column][row];
+            auto it = class_index.find(value);
+            if(it == class_index.end()) {
+                it = class_index.emplace(value, profile.class_values.size()).first;
+                profile.class_values.push_back(value);
+                profile.class_cumulative.push_back(0);
+            }
+            row_class[row] = it->second;
+            profile.class_cumulative[it->second]++;
+        }
+        if(profile.class_values.size() > kMaxDiscreteValues) throw std::invalid_argument("Label column is not discrete.");
+        to_cumulative(profile.class_cumulative);
+
+        for(size_t col = 0; col < num_columns; col++) {
+            if(col != profile.label_column) learn_column(profile.columns[col], cells[col], row_class, profile.class_values.size());
+        }
+        return profile;
+    }
+
+    std::vector<ColumnProfile> columns;
+    size_t label_column = 0;
+    /// @brief Distinct label values and their cumulative frequencies.
+    std::vector<std::string> class_values;
+    std::vector<double> class_cumulative;
+
+    /// @brief Splits a CSV line on commas.
+    static std::vector<std::string> split(const std::string& line) {
+        std::vector<std::string> cells;
+        size_t start = 0;
+        while(true) {
+            size_t comma = line.find(',', start);
+            cells.push_back(line.substr(start, comma == std::string::npos ? std::string::npos : comma - start));
+            if(comma == std::string::npos) break;
+            start = comma + 1;
+        }
+        if(!cells.empty() && !cells.back().empty() && cells.back().back() == '\r') cells.back().pop_back();
+        return cells;
+    }
+
+private:
+    static bool parse_number(const std::string& text, double& value, int& decimals) {
+        if(text.empty()) return false;
+        char* end = nullptr;
+        value = std::strtod(text.c_str(), &end);
+        if(end != text.c_str() + text.size() || !std::isfinite(value)) return false;
+        size_t dot = text.find('.');
+        decimals = dot == std::string::npos ? 0 : static_cast<int>(text.size() - dot - 1);
+        return true;
+    }
+
+    static void to_cumulative(std::vector<double>& counts) {
+        double total = 0;
+        for(double count : counts) total += count;
+        double running = 0;
+        for(double& count : counts) {
+            running += count;
+            count = running / total;
+        }
+    }
+
+    static void learn_column(ColumnProfile& column, const std::vector<std::string>& cells, const std::vector<size_t>& row_class, size_t num_classes) {
+        std::vector<std::string> distinct;
+        std::map<std::string, size_t> index;
+        bool numeric = true;
+        for(const std::string& cell : cells) {
+            if(cell.empty()) continue;
+            double value;
+            int decimals;
+            if(!parse_number(cell, value, decimals)) numeric = false;
+            else column.decimals = std::max(column.decimals, decimals);
+            if(index.size() <= kMaxDiscreteValues && index.emplace(cell, distinct.size()).second) distinct.push_back(cell);
+        }
+        column.categorical = !numeric || index.size() <= kMaxDiscreteValues;
+        column.missing_rate.assign(num_classes, 0.0);
+        std::vector<size_t> class_rows(num_classes, 0);
+
+        if(column.categorical) {
+            // text columns may have any number of categories
+            for(const std::string& cell : cells) {
+                if(!cell.empty() && index.emplace(cell, distinct.size()).second) distinct.push_back(cell);
+            }
+            column.categories = distinct;
+            column.cumulative.assign(num_classes, std::vector<double>(distinct.size(), 0.0));
+            for(size_t row = 0; row < cells.size(); row++) {
+                class_rows[row_class[row]]++;
+                if(cells[row].empty()) column.missing_rate[row_class[row]]++;
+                else column.cumulative[row_class[row]][index[cells[row]]]++;
+            }
+            for(auto& counts : column.cumulative) {
+                if(!counts.empty()) to_cumulative(counts);
+            }
+        } else {
+            std::vector<std::vector<double>> values(num_classes);
+            for(size_t row = 0; row < cells.size(); row++) {
+                class_rows[row_class[row]]++;
+                double value;
+                int decimals;
+                if(parse_number(cells[row], value, decimals)) values[row_class[row]].push_back(value);
+                else column.missing_rate[row_class[row]]++;
+            }
+            column.quantiles.resize(num_classes);
+            for(size_t c = 0; c < num_classes; c++) {
+                std::vector<double>& sorted = values[c];
+                if(sorted.empty()) continue;
+                std::sort(sorted.begin(), sorted.end());
+                for(size_t q = 0; q <= kQuantiles; q++) {
+                    column.quantiles[c].push_back(sorted[(sorted.size() - 1) * q / kQuantiles]);
+                }
+            }
+        }
+        for(size_t c = 0; c < num_classes; c++) {
+            if(class_rows[c] > 0) column.missing_rate[c] /= class_rows[c];
+        }
+    }
+};
+
+/// @brief A block of generated rows, stored column by column. Numeric cells are doubles (NaN when missing), categorical cells are category codes (-1 when missing) stored as doubles.
+struct ColumnBlock {
+    size_t rows = 0;
+    std::vector<std::vector<double>> columns;
+};
+
+/// @brief Generates rows from a DatasetProfile. Block i is always generated from the same seed, so the output depends only on the seed and the block size, never on the number of threads.
+class SyntheticGenerator {
+public:
+    /// @param profile Learned profile.
+    /// @param seed Seed of the whole dataset.
+    SyntheticGenerator(const DatasetProfile& profile, uint64_t seed) : profile(profile), seed(seed) {}
+
+    /// @brief Fills @p block with @p rows rows of block number @p block_index.
+    void generate_block(uint64_t block_index, size_t rows, ColumnBlock& block) const {
+        uint64_t state = seed ^ (0x9E3779B97F4A7C15ULL * (block_index + 1));
+        block.rows = rows;
+        block.columns.assign(profile.columns.size(), std::vector<double>(rows));
+        for(size_t row = 0; row < rows; row++) {
+            size_t label = sample_index(profile.class_cumulative, uniform(state));
+            for(size_t col = 0; col < profile.columns.size(); col++) {
+                double& cell = block.columns[col][row];
+                if(col == profile.label_column) {
+                    cell = static_cast<double>(label);
+                    continue;
+                }
+                const ColumnProfile& column = profile.columns[col];
+                if(uniform(state) < column.missing_rate[label]) {
+                    cell = column.categorical ? -1.0 : std::numeric_limits<double>::quiet_NaN();
+                } else if(column.categorical) {
+                    cell = static_cast<double>(sample_index(column.cumulative[label], uniform(state)));
+                } else {
+                    cell = sample_quantile(column.quantiles[label], uniform(state), column.decimals);
+                }
+            }
+        }
+    }
+
+    /// @brief Appends the rows of a block to @p out as CSV lines.
+    void append_csv(const ColumnBlock& block, std::string& out) const {
+        for(size_t row = 0; row < block.rows; row++) {
+            for(size_t col = 0; col < block.columns.size(); col++) {
+                if(col > 0) out += ',';
+                double cell = block.columns[col][row];
+                if(col == profile.label_column) out += profile.class_values[static_cast<size_t>(cell)];
+                else if(profile.columns[col].categorical) {
+                    if(cell >= 0) out += profile.columns[col].categories[static_cast<size_t>(cell)];
+                }
+                else if(!std::isnan(cell)) append_fixed(out, cell, profile.columns[col].decimals);
+            }
+            out += '\n';
+        }
+    }
+
+    /// @brief Header line of the CSV output.
+    std::string csv_header() const {
+        std::string header;
+        for(size_t col = 0; col < profile.columns.size(); col++) {
+            if(col > 0) header += ',';
+            header += profile.columns[col].name;
+        }
+        return header + "\n";
+    }
+
+    const DatasetProfile& get_profile() const { return profile; }
+
+    /// @brief Writes @p rows rows to @p out, generating and formatting blocks in parallel on the shared pool and writing them in order.
+    /// @param binary Write the blocked binary columnar format (see BinaryColumnWriter) instead of CSV.
+    /// @param block_rows Rows per block; part of what determines the output for a given seed.
+    /// @param num_threads Threads to use, 0 for the whole shared pool.
+    void write(std::ostream& out, uint64_t rows, bool binary, size_t block_rows = 65536, size_t num_threads = 0) const;
+
+private:
+    /// @brief splitmix64 step, a uniform double in [0, 1).
+    static double uniform(uint64_t& state) {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        z ^= z >> 31;
+        return (z >> 11) * 0x1.0p-53;
+    }
+
+    static size_t sample_index(const std::vector<double>& cumulative, double u) {
+        size_t index = std::upper_bound(cumulative.begin(), cumulative.end(), u) - cumulative.begin();
+        return std::min(index, cumulative.size() - 1);
+    }
+
+    static double sample_quantile(const std::vector<double>& quantiles, double u, int decimals) {
+        if(quantiles.empty()) return std::numeric_limits<double>::quiet_NaN();
+        double position = u * (quantiles.size() - 1);
+        size_t i = static_cast<size_t>(position);
+        double value = i + 1 < quantiles.size() ? quantiles[i] + (quantiles[i + 1] - quantiles[i]) * (position - i) : quantiles.back();
+        double scale = std::pow(10.0, decimals);
+        return std::round(value * scale) / scale;
+    }
+
+    /// @brief Appends @p value with exactly @p decimals digits after the point; much faster than printf for the billions of cells a large run formats.
+    static void append_fixed(std::string& out, double value, int decimals) {
+        if(decimals > 15 || std::fabs(value) > 9e15 / std::pow(10.0, decimals)) {
+            std::ostringstream text;
+            text.precision(17);
+            text << value;
+            out += text.str();
+            return;
+        }
+        uint64_t scale = 1;
+        for(int i = 0; i < decimals; i++) scale *= 10;
+        int64_t scaled = static_cast<int64_t>(std::llround(value * scale));
+        if(scaled < 0) {
+            out += '-';
+            scaled = -scaled;
+        }
+        out += std::to_string(static_cast<uint64_t>(scaled) / scale);
+        if(decimals > 0) {
+            std::string fraction = std::to_string(static_cast<uint64_t>(scaled) % scale);
+            out += '.';
+            out.append(decimals - fraction.size(), '0');
+            out += fraction;
+        }
+    }
+
+    const DatasetProfile& profile;
+    uint64_t seed;
+};
+
+/// @brief Writer of the blocked binary columnar format.
+/// @details Layout (native little-endian):
+/// - magic "LRPCOLS1", uint32 column count, then per column: uint8 kind (0 numeric, 1 categorical), uint32 name length and name bytes,
+///   and for categorical columns a uint32 category count followed by (uint32 length, bytes) per category;
+/// - blocks: uint32 row count, then every column's cells contiguously, doubles for numeric columns (NaN when missing)
+///   and int32 category codes for categorical columns (-1 when missing);
+/// - a block with a row count of 0 ends the file.
+/// The label column is written as a categorical column over DatasetProfile::class_values.
+class BinaryColumnWriter {
+public:
+    BinaryColumnWriter(std::ostream& out, const DatasetProfile& profile) : out(out), profile(profile) {}
+
+    void write_header() {
+        out.write("LRPCOLS1", 8);
+        put<uint32_t>(static_cast<uint32_t>(profile.columns.size()));
+        for(size_t col = 0; col < profile.columns.size(); col++) {
+            const ColumnProfile& column = profile.columns[col];
+            bool label = col == profile.label_column;
+            put<uint8_t>(label || column.categorical ? 1 : 0);
+            put_string(column.name);
+            if(label || column.categorical) {
+                const std::vector<std::string>& categories = label ? profile.class_values : column.categories;
+                put<uint32_t>(static_cast<uint32_t>(categories.size()));
+                for(const std::string& category : categories) put_string(category);
+            }
+        }
+    }
+
+    /// @brief Serializes a block into @p bytes, which can be done in parallel and written later with write_bytes.
+    void encode_block(const ColumnBlock& block, std::string& bytes) const {
+        append<uint32_t>(bytes, static_cast<uint32_t>(block.rows));
+        for(size_t col = 0; col < block.columns.size(); col++) {
+            if(col == profile.label_column || profile.columns[col].categorical) {
+                for(double cell : block.columns[col]) append<int32_t>(bytes, static_cast<int32_t>(cell));
+            } else {
+                for(double cell : block.columns[col]) append<double>(bytes, cell);
+            }
+        }
+    }
+
+    void write_bytes(const std::string& bytes) { out.write(bytes.data(), bytes.size()); }
+
+    void write_end() { put<uint32_t>(0); }
+
+private:
+    template <typename T>
+    static void append(std::string& bytes, T value) {
+        char raw[sizeof(T)];
+        std::memcpy(raw, &value, sizeof(T));
+        bytes.append(raw, sizeof(T));
+    }
+
+    template <typename T>
+    void put(T value) { out.write(reinterpret_cast<const char*>(&value), sizeof(T)); }
+
+    void put_string(const std::string& text) {
+        put<uint32_t>(static_cast<uint32_t>(text.size()));
+        out.write(text.data(), text.size());
+    }
+
+    std::ostream& out;
+    const DatasetProfile& profile;
+};
+
+/// @brief Reader of the blocked binary columnar format written by BinaryColumnWriter. Reads one block at a time, so memory stays bounded by the block size.
+class BinaryColumnReader {
+public:
+    struct Column {
+        std::string name;
+        bool categorical = false;
+        std::vector<std::string> categories;
+    };
+
+    /// @throws std::runtime_error if the stream does not start with a valid header.
+    explicit BinaryColumnReader(std::istream& in) : in(in) {
+        char magic[8];
+        if(!in.read(magic, 8) || std::string(magic, 8) != "LRPCOLS1") throw std::runtime_error("Not a binary column file.");
+        uint32_t num_columns = get<uint32_t>();
+        columns.resize(num_columns);
+        for(Column& column : columns) {
+            column.categorical = get<uint8_t>() != 0;
+            column.name = get_string();
+            if(column.categorical) {
+                uint32_t count = get<uint32_t>();
+                for(uint32_t i = 0; i < count; i++) column.categories.push_back(get_string());
+            }
+        }
+    }
+
+    /// @brief Reads the next block; categorical cells come back as codes (-1 when missing). Returns false at the end of the file.
+    bool next_block(ColumnBlock& block) {
+        uint32_t rows = get<uint32_t>();
+        if(rows == 0) return false;
+        block.rows = rows;
+        block.columns.resize(columns.size());
+        for(size_t col = 0; col < columns.size(); col++) {
+            std::vector<double>& cells = block.columns[col];
+            cells.resize(rows);
+            if(columns[col].categorical) {
+                std::vector<int32_t> codes(rows);
+                read_raw(codes.data(), rows * sizeof(int32_t));
+                for(size_t row = 0; row < rows; row++) cells[row] = codes[row];
+            } else {
+                read_raw(cells.data(), rows * sizeof(double));
+            }
+        }
+        return true;
+    }
+
+    std::vector<Column> columns;
+
+private:
+    void read_raw(void* data, size_t bytes) {
+        if(!in.read(static_cast<char*>(data), bytes)) throw std::runtime_error("Truncated binary column file.");
+    }
+
+    template <typename T>
+    T get() {
+        T value;
+        read_raw(&value, sizeof(T));
+        return value;
+    }
+
+    std::string get_string() {
+        std::string text(get<uint32_t>(), '\0');
+        if(!text.empty()) read_raw(&text[0], text.size());
+        return text;
+    }
+
+    std::istream& in;
+};
+
+inline void SyntheticGenerator::write(std::ostream& out, uint64_t rows, bool binary, size_t block_rows, size_t num_threads) const {
+    ThreadPool& pool = ThreadPool::global();
+    BinaryColumnWriter writer(out, profile);
+    if(binary) writer.write_header();
+    else out << csv_header();
+
+    // blocks are produced a wave at a time so memory stays bounded however many rows are asked for
+    uint64_t num_blocks = (rows + block_rows - 1) / block_rows;
+    size_t wave = 2 * (num_threads == 0 ? pool.concurrency() : num_threads);
+    std::vector<std::string> encoded(wave);
+    for(uint64_t first = 0; first < num_blocks; first += wave) {
+        size_t count = static_cast<size_t>(std::min<uint64_t>(wave, num_blocks - first));
+        pool.parallel_for(count, [&](size_t i) {
+            uint64_t index = first + i;
+            size_t block_size = static_cast<size_t>(std::min<uint64_t>(block_rows, rows - index * block_rows));
+            ColumnBlock block;
+            generate_block(index, block_size, block);
+            encoded[i].clear();
+            if(binary) writer.encode_block(block, encoded[i]);
+            else append_csv(block, encoded[i]);
+        }, num_threads);
+        for(size_t i = 0; i < count; i++) {
+            if(binary) writer.write_bytes(encoded[i]);
+            else out << encoded[i];
+        }
+    }
+    if(binary) writer.write_end();
+}
+
+#endif // SYNTHETICDATA_H
@@ -0,0 +1,62 @@
+#include "CoreLogic/CompiledForest.h"
+#include "Includes/CommandLine.h"
+#include <iostream>
+#include <string>
+
+// Compiles a saved RandomForest model into a shared object that CompiledForest can load, and that
+// lrp-score and lrp-serve score with under --backend compiled --compiled-library <library.so>.
+// Usage: ForestCompiler --model <file> --output <library.so> [--source <generated.cpp>] [--compiler <command>] [--flags <flags>]
+//                       [--log-level debug|info|warning|error]
+
+namespace {
+
+void usage(const char* program) {
+    std::cerr << "Usage: " << program << " --model <file> --output <library.so> [--source <generated.cpp>] [--compiler <command>] [--flags <flags>]"
+              << " [--log-level debug|info|warning|error]" << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    std::string model_path, library_path, source_path, compiler;
+    std::string flags = "-O2";
+    LogLevel log_level = LogLevel::Warning;
+    try {
+        for (int i = 1; i < argc; i++) {
+            std::string flag = argv[i];
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+                return 1;
+            }
+            std::string value = argv[++i];
+            if (flag == "--model") model_path = value;
+            else if (flag == "--output") library_path = value;
+            else if (flag == "--source") source_path = value;
+            else if (flag == "--compiler") compiler = value;
+            else if (flag == "--flags") flags = value;
+            else if (flag == "--log-level") log_level = parse_log_level(value);
+            else {
+                std::cerr << "Unknown option: " << flag << std::endl;
+                usage(argv[0]);
+                return 1;
+            }
+        }
+        if (model_path.empty() || library_path.empty()) {
+            usage(argv[0]);
+            return 1;
+        }
+        if (source_path.empty()) source_path = library_path + ".cpp";
+        Logger::global().set_level(log_level);
+
+        RandomForest forest(0);
+        forest.load(model_path);
+        ForestCodeGenerator::generate(forest, source_path);
+        ForestCodeGenerator::compile(source_path, library_path, compiler, flags);
+        CompiledForest compiled(library_path);   // check that the library loads
+        std::cout << "Compiled " << compiled.num_trees() << " trees into " << library_path << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,67 @@
+#include "DataProcessing/SyntheticData.h"
+#include <fstream>
+#include <iostream>
+#include <string>
+
+// Generates a synthetic dataset of any size with the column distributions of a source CSV, for scale testing.
+// Usage: GenerateData <input.csv> <output> <rows> [--seed N] [--format csv|binary] [--threads N] [--block-rows N] [--label-column N]
+int main(int argc, char* argv[]) {
+    if (argc < 4) {
+        std::cerr << "Usage: " << argv[0] << " <input.csv> <output> <rows> [--seed N] [--format csv|binary] [--threads N] [--block-rows N] [--label-column N]" << std::endl;
+        return 1;
+    }
+    std::string input_path = argv[1];
+    std::string output_path = argv[2];
+    uint64_t seed = 42;
+    std::string format = "csv";
+    size_t threads = 0;
+    size_t block_rows = 65536;
+    int label_column = -1;
+
+    try {
+        uint64_t rows = std::stoull(argv[3]);
+        for (int i = 4; i + 1 < argc; i += 2) {
+            std::string flag = argv[i];
+            if (flag == "--seed") seed = std::stoull(argv[i + 1]);
+            else if (flag == "--format") format = argv[i + 1];
+            else if (flag == "--threads") threads = std::stoul(argv[i + 1]);
+            else if (flag == "--block-rows") block_rows = std::stoul(argv[i + 1]);
+            else if (flag == "--label-column") label_column = std::stoi(argv[i + 1]);
+            else {
+                std::cerr << "Unknown option: " << flag << std::endl;
+                return 1;
+            }
+        }
+        if (format != "csv" && format != "binary") {
+            std::cerr << "Unknown format: " << format << std::endl;
+            return 1;
+        }
+        if (block_rows == 0) {
+            std::cerr << "--block-rows must be positive" << std::endl;
+            return 1;
+        }
+
+        std::ifstream input(input_path);
+        if (!input) {
+            std::cerr << "Cannot open " << input_path << std::endl;
+            return 1;
+        }
+        DatasetProfile profile = DatasetProfile::learn(input, label_column);
+        std::ofstream output(output_path, std::ios::binary);
+        if (!output) {
+            std::cerr << "Cannot write " << output_path << std::endl;
+            return 1;
+        }
+        SyntheticGenerator generator(profile, seed);
+        generator.write(output, rows, format == "binary", block_rows, threads);
+        if (!output) {
+            std::cerr << "Error writing " << output_path << std::endl;
+            return 1;
+        }
+        std::cout << "Wrote " << rows << " rows to " << output_path << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
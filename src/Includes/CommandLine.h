@@ -0,0 +1,74 @@
+/**
+ * @file CommandLine.h
+ * @brief Parsers for the command line values shared by the lrp-* tools: column index lists, inference and scoring backends, probability modes and log levels.
+ * @version 0.1
+ * @date 2024-06-20
+ */
+
+// Create header guard
+#ifndef COMMANDLINE_H
+#define COMMANDLINE_H
+
+#include "../CoreLogic/RandomForest.h"
+#include "Logger.h"
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/// @brief Parses a comma-separated list of column indexes such as "0,1". Empty items are skipped.
+inline std::vector<int> parse_index_list(const std::string& text) {
+    std::vector<int> indexes;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) indexes.push_back(std::stoi(item));
+    }
+    return indexes;
+}
+
+/// @brief Parses --backend traversal|quickscorer|simd|quantized.
+/// @throws std::invalid_argument for any other value.
+inline RandomForest::InferenceBackend parse_backend(const std::string& value) {
+    if (value == "traversal") return RandomForest::TraversalBackend;
+    if (value == "quickscorer") return RandomForest::QuickScorerBackend;
+    if (value == "simd") return RandomForest::SimdBackend;
+    if (value == "quantized") return RandomForest::QuantizedBackend;
+    throw std::invalid_argument("Unknown backend: " + value);
+}
+
+/// @brief --backend of the scoring tools: one of RandomForest's engines, or a library built by ForestCompiler.
+struct ScoringBackend {
+    RandomForest::InferenceBackend engine = RandomForest::SimdBackend;
+    bool compiled = false;          ///< Score with the CompiledForest given by --compiled-library instead of engine.
+};
+
+/// @brief Parses --backend traversal|quickscorer|simd|quantized|compiled.
+/// @throws std::invalid_argument for any other value.
+inline ScoringBackend parse_scoring_backend(const std::string& value) {
+    ScoringBackend backend;
+    if (value == "compiled") backend.compiled = true;
+    else backend.engine = parse_backend(value);
+    return backend;
+}
+
+/// @brief Parses --probability leaf|vote.
+/// @throws std::invalid_argument for any other value.
+inline RandomForest::ProbabilityMode parse_probability_mode(const std::string& value) {
+    if (value == "leaf") return RandomForest::LeafFrequency;
+    if (value == "vote") return RandomForest::VoteFraction;
+    throw std::invalid_argument("Unknown probability mode: " + value);
+}
+
+/// @brief Parses --log-level debug|info|warning|error.
+/// @throws std::invalid_argument for any other value.
+inline LogLevel parse_log_level(const std::string& value) {
+    if (value == "debug") return LogLevel::Debug;
+    if (value == "info") return LogLevel::Info;
+    if (value == "warning") return LogLevel::Warning;
+    if (value == "error") return LogLevel::Error;
+    throw std::invalid_argument("Unknown log level: " + value);
+}
+
+#endif // COMMANDLINE_H
@@ -34,15 +34,15 @@ public:
     }
     /// @brief Getter method for returning the feature name vector
     /// @return vector of strings for feature name vector. Indexed by columns
-    std::vector<std::string> get_feature_name_vec() { return feature_name_vec; }
+    const std::vector<std::string>& get_feature_name_vec() const { return feature_name_vec; }
 
     /// @brief Returns vector<vector<double>> of data content
     /// @return Data content vector of vectors
-    std::vector<std::vector<double>> get_data_vec() { return data_vec; }
+    const std::vector<std::vector<double>>& get_data_vec() const { return data_vec; }
 
     /// @brief Returns vector<double> of impute values
     /// @return Impute value vector
-    std::vector<double> get_impute_vec() { return impute_vec; }
+    const std::vector<double>& get_impute_vec() const { return impute_vec; }
 
     void impute_data() {
         for(size_t row = 0; row < this->data_vec.size(); row++) {
@@ -64,7 +64,7 @@ public:
     std::unordered_map<std::string, std::unordered_map<std::string, int>> get_categorical_groups() { return categorical_groups; }
 
     /// @return Returns the normalized data content 
-    std::vector<std::vector<double>> get_normalized_vector() { return normalized_vector; }
+    const std::vector<std::vector<double>>& get_normalized_vector() const { return normalized_vector; }
 
     /// @brief Normalizes a data by obtaining the sum of all columns and dividing each specific value by that sum.
     /// @param vec The vector to be normalized.
@@ -0,0 +1,229 @@
+/**
+ * @file Instrumentation.h
+ * @brief A header that contains the phase timers and counters used to see where training and scoring time goes.
+ * @version 0.1
+ * @date 2024-06-10
+ */
+
+// Create header guard
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/// @brief Wall and CPU time spent in one named phase.
+struct PhaseStats {
+    uint64_t calls = 0;
+    double wall_seconds = 0.0;
+    /// @brief CPU time of the thread that ran the phase. Work handed to the thread pool is not included, so that
+    /// phases running concurrently on other threads are not charged to this one; pool workers time their own phases.
+    double cpu_seconds = 0.0;
+};
+
+/// @brief Snapshot of the counters and phases, returned by Instrumentation::report.
+struct InstrumentationReport {
+    /// @brief Counter values, indexed by Instrumentation::Counter.
+    std::array<uint64_t, 6> counters{};
+    /// @brief Phases by name, nested phases are named "outer/inner" by convention.
+    std::map<std::string, PhaseStats> phases;
+
+    uint64_t counter(size_t which) const { return counters[which]; }
+
+    /// @return The stats of a phase, all zero if it never ran.
+    PhaseStats phase(const std::string& name) const {
+        auto it = phases.find(name);
+        return it == phases.end() ? PhaseStats() : it->second;
+    }
+
+    /// @brief Writes the counters and phases as one JSON object.
+    void write_json(std::ostream& out) const;
+};
+
+/// @brief Process-wide registry of counters and phase timings.
+/// Counters are relaxed atomics, phases are aggregated under a mutex when their scope closes, so instrumentation belongs
+/// on per-node, per-level and per-batch work, never per row. Building with LRP_DISABLE_INSTRUMENTATION turns the
+/// LRP_PHASE and LRP_COUNT macros into no-ops; the registry then stays empty.
+class Instrumentation {
+public:
+    enum Counter {
+        NodesBuilt,             ///< Tree nodes finalized as a split or a leaf.
+        SplitsEvaluated,        ///< Per-feature split searches.
+        RowsPartitioned,        ///< Rows moved to a child by a split.
+        BytesAllocated,         ///< Node memory reserved by tree arenas.
+        TreesTrained,
+        RowsScored,             ///< Rows scored by the batch APIs.
+        NumCounters
+    };
+
+    static Instrumentation& global() {
+        static Instrumentation instance;
+        return instance;
+    }
+
+    static const char* counter_name(size_t which) {
+        static const char* names[NumCounters] = {"nodes_built", "splits_evaluated", "rows_partitioned", "bytes_allocated", "trees_trained", "rows_scored"};
+        return names[which];
+    }
+
+    void add(Counter which, uint64_t amount) { counters[which].fetch_add(amount, std::memory_order_relaxed); }
+
+    /// @brief Adds one run of a phase. Called by ScopedPhase.
+    void record(const char* name, std::chrono::steady_clock::time_point start, double wall_seconds, double cpu_seconds) {
+        std::lock_guard<std::mutex> lock(mutex);
+        PhaseStats& stats = phases[name];
+        stats.calls++;
+        stats.wall_seconds += wall_seconds;
+        stats.cpu_seconds += cpu_seconds;
+        if(tracing && events.size() < max_events) {
+            double start_us = std::chrono::duration<double, std::micro>(start - epoch).count();
+            events.push_back({name, start_us, wall_seconds * 1e6, thread_number()});
+        }
+    }
+
+    /// @brief Also keeps every phase run as a Chrome trace event, up to @p limit events.
+    void set_tracing(bool enabled, size_t limit = 1000000) {
+        std::lock_guard<std::mutex> lock(mutex);
+        tracing = enabled;
+        max_events = limit;
+    }
+
+    /// @brief Zeroes every counter and forgets every phase and trace event.
+    void reset() {
+        for(auto& counter : counters) counter.store(0, std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(mutex);
+        phases.clear();
+        events.clear();
+    }
+
+    InstrumentationReport report() const {
+        InstrumentationReport snapshot;
+        for(size_t i = 0; i < NumCounters; i++) snapshot.counters[i] = counters[i].load(std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(mutex);
+        snapshot.phases = phases;
+        return snapshot;
+    }
+
+    void write_json(std::ostream& out) const { report().write_json(out); }
+
+    /// @brief Writes the traced phases in the Chrome trace event format, for chrome://tracing or Perfetto.
+    /// Counters are added as one counter event at the end of the trace.
+    void write_chrome_trace(std::ostream& out) const {
+        InstrumentationReport snapshot = report();
+        std::lock_guard<std::mutex> lock(mutex);
+        out << "{\"traceEvents\":[";
+        double end_us = 0.0;
+        for(size_t i = 0; i < events.size(); i++) {
+            const TraceEvent& event = events[i];
+            out << (i == 0 ? "\n" : ",\n") << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread
+                << ",\"ts\":" << event.start_us << ",\"dur\":" << event.duration_us << "}";
+            end_us = std::max(end_us, event.start_us + event.duration_us);
+        }
+        out << (events.empty() ? "\n" : ",\n") << "{\"name\":\"counters\",\"ph\":\"C\",\"pid\":1,\"tid\":0,\"ts\":" << end_us << ",\"args\":{";
+        for(size_t i = 0; i < NumCounters; i++) {
+            out << (i == 0 ? "" : ",") << "\"" << counter_name(i) << "\":" << snapshot.counters[i];
+        }
+        out << "}}\n],\"displayTimeUnit\":\"ms\"}\n";
+    }
+
+    /// @return CPU seconds used so far by the calling thread.
+    static double thread_cpu_seconds() {
+#ifdef CLOCK_THREAD_CPUTIME_ID
+        timespec now;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+        return now.tv_sec + now.tv_nsec * 1e-9;
+#else
+        return std::clock() / static_cast<double>(CLOCKS_PER_SEC);
+#endif
+    }
+
+private:
+    struct TraceEvent {
+        const char* name;
+        double start_us;
+        double duration_us;
+        size_t thread;
+    };
+
+    Instrumentation() : epoch(std::chrono::steady_clock::now()) {
+        for(auto& counter : counters) counter.store(0, std::memory_order_relaxed);
+    }
+
+    /// @brief Small stable number of the calling thread, for the trace's tid. The mutex is held.
+    size_t thread_number() {
+        auto it = thread_numbers.emplace(std::this_thread::get_id(), thread_numbers.size() + 1).first;
+        return it->second;
+    }
+
+    std::array<std::atomic<uint64_t>, NumCounters> counters;
+    mutable std::mutex mutex;
+    std::map<std::string, PhaseStats> phases;
+    bool tracing = false;
+    size_t max_events = 0;
+    std::vector<TraceEvent> events;
+    std::unordered_map<std::thread::id, size_t> thread_numbers;
+    std::chrono::steady_clock::time_point epoch;
+};
+
+/// @brief Times the enclosing scope as one run of a phase. @p name must outlive the program (a string literal).
+class ScopedPhase {
+public:
+    explicit ScopedPhase(const char* name)
+        : name(name), start(std::chrono::steady_clock::now()), cpu_start(Instrumentation::thread_cpu_seconds()) {}
+
+    ~ScopedPhase() {
+        double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        Instrumentation::global().record(name, start, wall, Instrumentation::thread_cpu_seconds() - cpu_start);
+    }
+
+    ScopedPhase(const ScopedPhase&) = delete;
+    ScopedPhase& operator=(const ScopedPhase&) = delete;
+
+private:
+    const char* name;
+    std::chrono::steady_clock::time_point start;
+    double cpu_start;
+};
+
+inline void InstrumentationReport::write_json(std::ostream& out) const {
+    out << "{\n  \"counters\": {";
+    for(size_t i = 0; i < counters.size(); i++) {
+        out << (i == 0 ? "\n" : ",\n") << "    \"" << Instrumentation::counter_name(i) << "\": " << counters[i];
+    }
+    out << "\n  },\n  \"phases\": {";
+    bool first = true;
+    for(const auto& phase : phases) {
+        out << (first ? "\n" : ",\n") << "    \"" << phase.first << "\": {\"calls\": " << phase.second.calls
+            << ", \"wall_seconds\": " << phase.second.wall_seconds << ", \"cpu_seconds\": " << phase.second.cpu_seconds << "}";
+        first = false;
+    }
+    out << "\n  }\n}\n";
+}
+
+static_assert(Instrumentation::NumCounters == 6, "InstrumentationReport::counters must hold every counter");
+
+#define LRP_CONCAT_INNER(a, b) a##b
+#define LRP_CONCAT(a, b) LRP_CONCAT_INNER(a, b)
+
+#ifdef LRP_DISABLE_INSTRUMENTATION
+#define LRP_PHASE(name) ((void)0)
+#define LRP_COUNT(counter, amount) ((void)0)
+#else
+/// @brief Times the rest of the enclosing scope as phase @p name.
+#define LRP_PHASE(name) ScopedPhase LRP_CONCAT(lrp_phase_, __LINE__)(name)
+/// @brief Adds @p amount to Instrumentation::counter.
+#define LRP_COUNT(counter, amount) Instrumentation::global().add(Instrumentation::counter, (amount))
+#endif
+
+#endif // INSTRUMENTATION_H
@@ -0,0 +1,333 @@
+/**
+ * @file Logger.h
+ * @brief A header that contains the asynchronous, leveled and rate-limited logger used by ingest, training and scoring.
+ * @version 0.1
+ * @date 2024-06-11
+ */
+
+// Create header guard
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class LogLevel { Debug = 0, Info = 1, Warning = 2, Error = 3, Off = 4 };
+
+inline const char* log_level_name(LogLevel level) {
+    static const char* names[] = {"DEBUG", "INFO", "WARN", "ERROR", "OFF"};
+    return names[static_cast<int>(level)];
+}
+
+/// @brief One call site of LRP_LOG. Counts every occurrence, logged or not, and rate-limits how many are written.
+/// Events register with the logger when built and unregister when destroyed, which for the static events of LRP_LOG
+/// happens at exit, before the logger itself: each is built after the logger, so it is destroyed first.
+class LogEvent {
+public:
+    explicit LogEvent(const char* name);
+    ~LogEvent();
+
+    LogEvent(const LogEvent&) = delete;
+    LogEvent& operator=(const LogEvent&) = delete;
+
+    /// @brief Counts one occurrence.
+    /// @return True if the occurrence should be written: its level is enabled and the event is under its rate limit.
+    bool occur(LogLevel level);
+
+    const char* name() const { return event_name; }
+    uint64_t count() const { return total.load(std::memory_order_relaxed); }
+
+    /// @brief Takes the occurrences suppressed since the last "suppressed" line, resetting them to 0.
+    /// @param ended_window_only Leaves them in place while the event's one-second window is still open.
+    /// @param level Set to the level of the last suppressed occurrence.
+    uint64_t take_suppressed(bool ended_window_only, LogLevel& level);
+
+private:
+    static int64_t now_ms() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    const char* event_name;
+    std::atomic<uint64_t> total{0};
+    std::atomic<int64_t> window_start_ms{0};
+    std::atomic<uint32_t> window_count{0};
+    std::atomic<uint64_t> suppressed{0};
+    std::atomic<int> suppressed_level{static_cast<int>(LogLevel::Warning)};
+};
+
+/// @brief Process-wide logger.
+/// Callers only format the message and push it on a bounded queue; a background thread writes the queue to the
+/// console stream and the log file, flushing once per batch instead of once per line. Every call site is an event
+/// with its own counter, and at most rate_limit() lines per event are written per second, the rest being summarized
+/// as one "suppressed" line. The summary is written when the event next fires, or by the writer thread within a second
+/// of the window ending, and is never held back past flush() or shutdown. When the queue is full lines are dropped and
+/// counted rather than blocking the caller.
+class Logger {
+public:
+    static Logger& global() {
+        static Logger instance;
+        return instance;
+    }
+
+    ~Logger() {
+        summarize_suppressed(false);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        writer.join();
+    }
+
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    /// @brief Lines below @p level are counted but not formatted nor written. Default is Warning.
+    void set_level(LogLevel level) { min_level.store(static_cast<int>(level), std::memory_order_relaxed); }
+    LogLevel level() const { return static_cast<LogLevel>(min_level.load(std::memory_order_relaxed)); }
+    bool enabled(LogLevel level) const { return static_cast<int>(level) >= min_level.load(std::memory_order_relaxed); }
+
+    /// @brief Lines written per event and per second before the event is suppressed. Default is 10.
+    void set_rate_limit(uint32_t lines_per_second) { rate_limit_per_second.store(lines_per_second, std::memory_order_relaxed); }
+    uint32_t rate_limit() const { return rate_limit_per_second.load(std::memory_order_relaxed); }
+
+    /// @brief Console stream lines are written to, nullptr for none. Default is std::clog.
+    void set_console(std::ostream* stream) {
+        flush();
+        std::lock_guard<std::mutex> lock(output_mutex);
+        console = stream;
+    }
+
+    /// @brief Also writes every line to @p path, appending if @p append.
+    /// @return False if the file could not be opened.
+    bool open_file(const std::string& path, bool append = true) {
+        flush();
+        std::lock_guard<std::mutex> lock(output_mutex);
+        file.close();
+        file.clear();
+        file.open(path, append ? std::ios::app : std::ios::trunc);
+        return file.is_open();
+    }
+
+    void close_file() {
+        flush();
+        std::lock_guard<std::mutex> lock(output_mutex);
+        file.close();
+    }
+
+    /// @brief Queues one line. Usually called through LRP_LOG, which checks the level and rate limit first.
+    void write(LogLevel level, const char* event, const std::string& message) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(queue.size() >= max_queued) {
+                dropped++;
+                return;
+            }
+            queue.push_back({std::chrono::system_clock::now(), level, event, message});
+        }
+        wake.notify_one();
+    }
+
+    /// @brief Writes the pending "suppressed" lines, then blocks until every queued line is written and the outputs are flushed.
+    void flush() {
+        summarize_suppressed(false);
+        std::unique_lock<std::mutex> lock(mutex);
+        uint64_t target = enqueued_total();
+        drained.wait(lock, [&] { return written >= target; });
+    }
+
+    /// @return Occurrences of every event, summed over the call sites sharing its name.
+    std::map<std::string, uint64_t> event_counts() const {
+        std::map<std::string, uint64_t> counts;
+        std::lock_guard<std::mutex> lock(events_mutex);
+        for(const LogEvent* event : events) counts[event->name()] += event->count();
+        return counts;
+    }
+
+    /// @return Occurrences of @p name.
+    uint64_t event_count(const std::string& name) const {
+        std::map<std::string, uint64_t> counts = event_counts();
+        auto it = counts.find(name);
+        return it == counts.end() ? 0 : it->second;
+    }
+
+    /// @return Lines dropped because the queue was full.
+    uint64_t dropped_count() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return dropped;
+    }
+
+private:
+    friend class LogEvent;
+
+    struct Record {
+        std::chrono::system_clock::time_point time;
+        LogLevel level;
+        const char* event;
+        std::string message;
+    };
+
+    Logger() : writer([this] { writer_loop(); }) {}
+
+    void register_event(LogEvent* event) {
+        std::lock_guard<std::mutex> lock(events_mutex);
+        events.push_back(event);
+    }
+
+    /// @brief Forgets a destroyed event, queueing its "suppressed" line first as ~Logger can no longer see it.
+    void unregister_event(LogEvent* event) {
+        std::lock_guard<std::mutex> lock(events_mutex);
+        summarize_suppressed(event, false);
+        events.erase(std::find(events.begin(), events.end(), event));
+    }
+
+    /// @brief Lines ever queued. The mutex is held.
+    uint64_t enqueued_total() const { return written + in_flight + queue.size(); }
+
+    /// @brief Queues the "suppressed" line of every event holding suppressed occurrences, or only of those whose window ended.
+    void summarize_suppressed(bool ended_windows_only) {
+        std::lock_guard<std::mutex> lock(events_mutex);
+        for(LogEvent* event : events) summarize_suppressed(event, ended_windows_only);
+    }
+
+    /// @brief Queues the "suppressed" line of one event if it holds any. The events mutex is held.
+    void summarize_suppressed(LogEvent* event, bool ended_window_only) {
+        LogLevel level;
+        uint64_t skipped = event->take_suppressed(ended_window_only, level);
+        if(skipped > 0) write(level, event->name(), "suppressed " + std::to_string(skipped) + " similar lines");
+    }
+
+    void writer_loop() {
+        std::vector<Record> batch;
+        std::unique_lock<std::mutex> lock(mutex);
+        while(true) {
+            //an idle second summarizes events that went quiet while suppressed, as nothing else would
+            if(!wake.wait_for(lock, std::chrono::seconds(1), [&] { return stopping || !queue.empty(); })) {
+                lock.unlock();
+                summarize_suppressed(true);
+                lock.lock();
+                continue;
+            }
+            if(queue.empty() && stopping) break;
+            batch.assign(std::make_move_iterator(queue.begin()), std::make_move_iterator(queue.end()));
+            queue.clear();
+            in_flight = batch.size();
+            lock.unlock();
+            write_batch(batch);
+            lock.lock();
+            written += in_flight;
+            in_flight = 0;
+            drained.notify_all();
+        }
+    }
+
+    void write_batch(const std::vector<Record>& batch) {
+        std::string text;
+        for(const Record& record : batch) {
+            std::time_t seconds = std::chrono::system_clock::to_time_t(record.time);
+            int millis = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(record.time.time_since_epoch()).count() % 1000);
+            std::tm local;
+            localtime_r(&seconds, &local);
+            char stamp[40];
+            std::strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &local);
+            char prefix[64];
+            std::snprintf(prefix, sizeof(prefix), "%s.%03d %-5s ", stamp, millis, log_level_name(record.level));
+            text += prefix;
+            text += '[';
+            text += record.event;
+            text += "] ";
+            text += record.message;
+            text += '\n';
+        }
+        std::lock_guard<std::mutex> lock(output_mutex);
+        if(console) console->write(text.data(), text.size()).flush();
+        if(file.is_open()) file.write(text.data(), text.size()).flush();
+    }
+
+    std::atomic<int> min_level{static_cast<int>(LogLevel::Warning)};
+    std::atomic<uint32_t> rate_limit_per_second{10};
+
+    mutable std::mutex mutex;                 ///< Guards the queue and the progress counters below.
+    std::condition_variable wake;
+    std::condition_variable drained;
+    std::deque<Record> queue;
+    static const size_t max_queued = 65536;
+    uint64_t written = 0;
+    uint64_t in_flight = 0;
+    uint64_t dropped = 0;
+    bool stopping = false;
+
+    std::mutex output_mutex;                  ///< Guards the outputs.
+    std::ostream* console = &std::clog;
+    std::ofstream file;
+
+    mutable std::mutex events_mutex;
+    std::vector<LogEvent*> events;
+
+    std::thread writer;                       ///< Last member, so it starts once everything above is built.
+};
+
+inline LogEvent::LogEvent(const char* name) : event_name(name) {
+    Logger::global().register_event(this);
+}
+
+inline LogEvent::~LogEvent() {
+    Logger::global().unregister_event(this);
+}
+
+inline bool LogEvent::occur(LogLevel level) {
+    total.fetch_add(1, std::memory_order_relaxed);
+    Logger& logger = Logger::global();
+    if(!logger.enabled(level)) return false;
+    int64_t now = now_ms();
+    int64_t start = window_start_ms.load(std::memory_order_relaxed);
+    if(now - start >= 1000 && window_start_ms.compare_exchange_strong(start, now, std::memory_order_relaxed)) {
+        window_count.store(0, std::memory_order_relaxed);
+        uint64_t skipped = suppressed.exchange(0, std::memory_order_relaxed);
+        if(skipped > 0) logger.write(level, event_name, "suppressed " + std::to_string(skipped) + " similar lines");
+    }
+    if(window_count.fetch_add(1, std::memory_order_relaxed) < logger.rate_limit()) return true;
+    suppressed_level.store(static_cast<int>(level), std::memory_order_relaxed);
+    suppressed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+inline uint64_t LogEvent::take_suppressed(bool ended_window_only, LogLevel& level) {
+    if(suppressed.load(std::memory_order_relaxed) == 0) return 0;
+    if(ended_window_only && now_ms() - window_start_ms.load(std::memory_order_relaxed) < 1000) return 0;
+    level = static_cast<LogLevel>(suppressed_level.load(std::memory_order_relaxed));
+    return suppressed.exchange(0, std::memory_order_relaxed);
+}
+
+/// @brief Logs `message` (anything that can be streamed, e.g. "row " << i) under @p event at @p level.
+/// The occurrence is always counted; the message is only formatted when it will be written.
+#define LRP_LOG(level, event, message)                                              \
+    do {                                                                            \
+        static LogEvent lrp_log_event(event);                                       \
+        if(lrp_log_event.occur(level)) {                                            \
+            std::ostringstream lrp_log_text;                                        \
+            lrp_log_text << message;                                                \
+            Logger::global().write(level, lrp_log_event.name(), lrp_log_text.str()); \
+        }                                                                           \
+    } while(0)
+
+#define LRP_LOG_DEBUG(event, message) LRP_LOG(LogLevel::Debug, event, message)
+#define LRP_LOG_INFO(event, message) LRP_LOG(LogLevel::Info, event, message)
+#define LRP_LOG_WARNING(event, message) LRP_LOG(LogLevel::Warning, event, message)
+#define LRP_LOG_ERROR(event, message) LRP_LOG(LogLevel::Error, event, message)
+
+#endif // LOGGER_H
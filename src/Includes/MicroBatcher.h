@@ -0,0 +1,196 @@
+/**
+ * @file MicroBatcher.h
+ * @brief A header that coalesces concurrent single-row scoring requests into batches, and records their latency.
+ * @version 0.1
+ * @date 2024-06-14
+ */
+
+// Create header guard
+#ifndef MICROBATCHER_H
+#define MICROBATCHER_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/// @brief Latencies of the most recent requests, for percentiles, plus running totals.
+/// Recording is a short critical section; percentiles copy and partially sort the window, so they belong on a stats request, not per row.
+class LatencyRecorder {
+public:
+    /// @param window Number of most recent latencies percentiles are computed over.
+    explicit LatencyRecorder(size_t window = 65536) : samples(window) {}
+
+    void record(std::chrono::steady_clock::duration latency) {
+        double micros = std::chrono::duration<double, std::micro>(latency).count();
+        std::lock_guard<std::mutex> lock(mutex);
+        samples[total % samples.size()] = micros;
+        total++;
+        sum_micros += micros;
+        max_micros = std::max(max_micros, micros);
+    }
+
+    /// @return The @p percentile (0 to 100) latency in microseconds over the window, 0 before any request.
+    double percentile(double percentile) const {
+        std::vector<double> window;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            window.assign(samples.begin(), samples.begin() + std::min<uint64_t>(total, samples.size()));
+        }
+        if(window.empty()) return 0.0;
+        size_t rank = static_cast<size_t>(percentile / 100.0 * (window.size() - 1) + 0.5);
+        std::nth_element(window.begin(), window.begin() + rank, window.end());
+        return window[rank];
+    }
+
+    uint64_t count() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return total;
+    }
+
+    /// @return Mean latency in microseconds over every request.
+    double mean() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return total == 0 ? 0.0 : sum_micros / total;
+    }
+
+    /// @return Largest latency in microseconds over every request.
+    double max() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return max_micros;
+    }
+
+private:
+    mutable std::mutex mutex;
+    std::vector<double> samples;
+    uint64_t total = 0;
+    double sum_micros = 0.0;
+    double max_micros = 0.0;
+};
+
+/// @brief Turns concurrent single-row requests into batch calls.
+/// Callers block in submit while one background thread scores everything queued so far with a single call of the batch
+/// function. With no wait configured, a request arriving at an idle batcher is scored at once and requests arriving while
+/// a batch is scored form the next one, so batches grow with the load and an idle server adds no delay. A positive wait
+/// holds a batch open for that long after its first request, trading latency for larger batches.
+template <typename Result>
+class MicroBatcher {
+public:
+    /// @brief Scores rows into a vector it resizes to rows.size().
+    using BatchFunction = std::function<void(const std::vector<std::vector<double>>&, std::vector<Result>&)>;
+
+    /// @param score Called on the batcher's thread only, so it may keep state between batches.
+    /// @param max_batch Largest number of rows per call of @p score.
+    /// @param max_wait How long a batch stays open for more requests after its first one.
+    MicroBatcher(BatchFunction score, size_t max_batch = 256, std::chrono::microseconds max_wait = std::chrono::microseconds(0))
+        : score(std::move(score)), max_batch(std::max<size_t>(max_batch, 1)), max_wait(max_wait), worker([this] { run(); }) {}
+
+    ~MicroBatcher() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        arrived.notify_all();
+        worker.join();
+    }
+
+    MicroBatcher(const MicroBatcher&) = delete;
+    MicroBatcher& operator=(const MicroBatcher&) = delete;
+
+    /// @brief Scores one row with whatever else is queued. Blocks until its batch is done.
+    /// @throws Whatever the batch function threw for the batch holding the row.
+    Result submit(std::vector<double> row) {
+        Request request;
+        request.row = std::move(row);
+        std::unique_lock<std::mutex> lock(mutex);
+        pending.push_back(&request);
+        arrived.notify_one();
+        finished.wait(lock, [&] { return request.done; });
+        if(request.error) std::rethrow_exception(request.error);
+        return std::move(request.result);
+    }
+
+    /// @return Batches scored so far.
+    uint64_t batch_count() const { return batches.load(std::memory_order_relaxed); }
+
+    /// @return Rows scored so far.
+    uint64_t row_count() const { return rows_scored.load(std::memory_order_relaxed); }
+
+    /// @return Largest batch scored so far.
+    size_t largest_batch() const { return largest.load(std::memory_order_relaxed); }
+
+private:
+    /// @brief Lives on the stack of the submitting thread until done is set.
+    struct Request {
+        std::vector<double> row;
+        Result result{};
+        std::exception_ptr error;
+        bool done = false;
+    };
+
+    void run() {
+        std::vector<Request*> batch;
+        std::vector<std::vector<double>> rows;
+        std::vector<Result> results;
+        std::unique_lock<std::mutex> lock(mutex);
+        while(true) {
+            arrived.wait(lock, [&] { return stopping || !pending.empty(); });
+            if(pending.empty()) break;
+            if(max_wait.count() > 0 && pending.size() < max_batch) {
+                auto deadline = std::chrono::steady_clock::now() + max_wait;
+                arrived.wait_until(lock, deadline, [&] { return stopping || pending.size() >= max_batch; });
+            }
+            size_t count = std::min(pending.size(), max_batch);
+            batch.assign(pending.begin(), pending.begin() + count);
+            pending.erase(pending.begin(), pending.begin() + count);
+            lock.unlock();
+
+            // the rows are swapped in and out rather than copied, the requests stay untouched until done is set
+            rows.resize(count);
+            for(size_t i = 0; i < count; i++) rows[i].swap(batch[i]->row);
+            std::exception_ptr error;
+            try {
+                score(rows, results);
+            } catch(...) {
+                error = std::current_exception();
+            }
+            batches.fetch_add(1, std::memory_order_relaxed);
+            rows_scored.fetch_add(count, std::memory_order_relaxed);
+            if(count > largest.load(std::memory_order_relaxed)) largest.store(count, std::memory_order_relaxed);
+
+            lock.lock();
+            for(size_t i = 0; i < count; i++) {
+                if(error) batch[i]->error = error;
+                else batch[i]->result = std::move(results[i]);
+                batch[i]->done = true;
+            }
+            finished.notify_all();
+        }
+    }
+
+    BatchFunction score;
+    const size_t max_batch;
+    const std::chrono::microseconds max_wait;
+
+    std::mutex mutex;                         ///< Guards pending, stopping and every Request::done.
+    std::condition_variable arrived;
+    std::condition_variable finished;
+    std::deque<Request*> pending;
+    bool stopping = false;
+
+    std::atomic<uint64_t> batches{0};
+    std::atomic<uint64_t> rows_scored{0};
+    std::atomic<size_t> largest{0};
+
+    std::thread worker;                       ///< Last member, so it starts once everything above is built.
+};
+
+#endif // MICROBATCHER_H
@@ -0,0 +1,198 @@
+/**
+ * @file ThreadPool.h
+ * @brief A header that contains the work-stealing thread pool shared by training and scoring.
+ * @version 0.1
+ * @date 2024-06-02
+ */
+
+// Create header guard
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// @brief Fixed-size work-stealing pool of worker threads.
+/// Every worker owns a deque: tasks it spawns go to the back of its own deque and are popped LIFO, idle workers steal from the front of the others.
+/// Tasks submitted from outside the pool go to a shared injection queue. The calling thread always takes part in parallel_for, so nested calls cannot deadlock.
+class ThreadPool {
+public:
+    /// @brief Starts the worker threads.
+    /// @param num_workers Number of worker threads. The calling thread is an extra participant in parallel_for.
+    explicit ThreadPool(size_t num_workers) {
+        for(size_t i = 0; i <= num_workers; i++) {
+            queues.emplace_back(new WorkQueue()); // the last queue is the injection queue
+        }
+        for(size_t i = 0; i < num_workers; i++) {
+            workers.emplace_back([this, i] { worker_loop(i); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+            stopping = true;
+        }
+        sleep_cv.notify_all();
+        for(std::thread& worker : workers) worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /// @brief Returns the process-wide pool, sized to the hardware concurrency.
+    static ThreadPool& global() {
+        static ThreadPool pool(std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() - 1 : 0);
+        return pool;
+    }
+
+    /// @return Number of threads that can work on a parallel_for at once (workers plus the caller).
+    size_t concurrency() const { return workers.size() + 1; }
+
+    /// @brief Calls fn(i) for every i in [0, n), spread over the pool. Returns once every call has finished.
+    /// If a call throws, the iterations not yet started are skipped and the first exception is rethrown here,
+    /// once no thread is still running fn.
+    /// @param n Number of iterations.
+    /// @param fn Function called with the iteration index.
+    /// @param max_threads Upper bound on participating threads, 0 for the whole pool. 1 runs serially on the caller.
+    void parallel_for(size_t n, const std::function<void(size_t)>& fn, size_t max_threads = 0) {
+        size_t threads = max_threads == 0 ? concurrency() : std::min(max_threads, concurrency());
+        if(threads > n) threads = n;
+        if(threads <= 1) {
+            for(size_t i = 0; i < n; i++) fn(i);
+            return;
+        }
+
+        auto state = std::make_shared<LoopState>(n, fn);
+        for(size_t i = 0; i + 1 < threads; i++) {
+            push([state] { state->run(); });
+        }
+
+        state->run();
+        std::unique_lock<std::mutex> lock(state->done_mutex);
+        state->done_cv.wait(lock, [&] { return state->done == state->n; });
+        if(state->error) std::rethrow_exception(state->error);
+    }
+
+private:
+    /// @brief Shared state of one parallel_for. Helpers that start late find no work left and never touch fn.
+    /// Never throws: the first exception of fn is kept for the caller, and every iteration is still counted as done.
+    struct LoopState {
+        LoopState(size_t count, const std::function<void(size_t)>& func) : n(count), fn(func) {}
+
+        void run() {
+            size_t finished = 0;
+            for(size_t i = next.fetch_add(1); i < n; i = next.fetch_add(1)) {
+                if(!failed.load(std::memory_order_relaxed)) {
+                    try {
+                        fn(i);
+                    } catch(...) {
+                        std::lock_guard<std::mutex> lock(done_mutex);
+                        if(!error) error = std::current_exception();
+                        failed.store(true, std::memory_order_relaxed);
+                    }
+                }
+                finished++;
+            }
+            if(finished == 0) return;
+            std::lock_guard<std::mutex> lock(done_mutex);
+            done += finished;
+            if(done == n) done_cv.notify_all();
+        }
+
+        const size_t n;
+        std::function<void(size_t)> fn;
+        std::atomic<size_t> next{0};
+        std::atomic<bool> failed{false};          ///< Set once fn threw; later iterations are skipped.
+        size_t done = 0;
+        std::exception_ptr error;                 ///< First exception of fn, guarded by done_mutex.
+        std::mutex done_mutex;
+        std::condition_variable done_cv;
+    };
+
+    /// @brief A deque of tasks guarded by its own lock, so owners and thieves only contend per queue.
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    /// @brief Pushes a task to the calling worker's own deque, or to the injection queue from outside the pool.
+    void push(std::function<void()> task) {
+        size_t index = worker_pool() == this ? worker_index() : workers.size();
+        {
+            std::lock_guard<std::mutex> lock(queues[index]->mutex);
+            queues[index]->tasks.push_back(std::move(task));
+            //counted before the queue unlocks: a thief can only pop the task, and decrement, after this
+            pending++;
+        }
+        { std::lock_guard<std::mutex> lock(sleep_mutex); }
+        sleep_cv.notify_one();
+    }
+
+    /// @brief Pops from the worker's own deque (newest first), then the injection queue, then steals (oldest first) from the others.
+    bool try_pop(size_t self, std::function<void()>& task) {
+        {
+            WorkQueue& own = *queues[self];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if(!own.tasks.empty()) {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                return true;
+            }
+        }
+        for(size_t k = 1; k < queues.size(); k++) {
+            WorkQueue& victim = *queues[(self + k) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if(!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void worker_loop(size_t index) {
+        worker_pool() = this;
+        worker_index() = index;
+        while(true) {
+            std::function<void()> task;
+            if(try_pop(index, task)) {
+                pending--;
+                task();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleep_mutex);
+            sleep_cv.wait(lock, [this] { return stopping || pending > 0; });
+            if(stopping && pending == 0) return;
+        }
+    }
+
+    static ThreadPool*& worker_pool() {
+        static thread_local ThreadPool* pool = nullptr;
+        return pool;
+    }
+
+    static size_t& worker_index() {
+        static thread_local size_t index = 0;
+        return index;
+    }
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::atomic<size_t> pending{0};
+    std::mutex sleep_mutex;
+    std::condition_variable sleep_cv;
+    bool stopping = false;
+};
+
+#endif // THREADPOOL_H
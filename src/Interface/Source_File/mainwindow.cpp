@@ -2,6 +2,7 @@
 #include "ui_mainwindow.h"
 #include "../Header_File/load_data.h"
 #include "../Header_File/evaluate_data.h"
+#include "../../Includes/Logger.h"
 #include <QFileDialog>
 #include <QMessageBox>
 
@@ -39,15 +40,13 @@ void MainWindow::on_LogFile_clicked()
                                                           QDir::homePath(),
                                                           QFileDialog::ShowDirsOnly | QFileDialog::DontResolveSymlinks);
     if (!directory.isEmpty()) {
-        // If a directory is selected, create the log file in that directory
+        // If a directory is selected, send the logger's output to a log file in that directory from now on
         QString fileName = directory + "/log.txt";
-        QFile file(fileName);
-        if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-            QTextStream out(&file);
-            out << "Log file created at: " << QDateTime::currentDateTime().toString() << "\n";
-            out << "User selected directory: " << directory << "\n";
-            out << "Additional information can be added here...\n";
-            file.close();
+        Logger& logger = Logger::global();
+        if (logger.open_file(fileName.toStdString())) {
+            if (!logger.enabled(LogLevel::Info)) logger.set_level(LogLevel::Info);
+            LRP_LOG_INFO("gui.log_file", "Log file opened in " << directory.toStdString());
+            logger.flush();
             QMessageBox::information(this, tr("Success"), tr("Log file saved to %1").arg(fileName));
         } else {
             QMessageBox::critical(this, tr("Error"), tr("Failed to create log file."));
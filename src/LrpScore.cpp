@@ -0,0 +1,316 @@
+#include "CoreLogic/RandomForest.h"
+#include "CoreLogic/CompiledForest.h"
+#include "CoreLogic/SuggestionGenerator.h"
+#include "Includes/CommandLine.h"
+#include "DataProcessing/DataHandler.h"
+#include "DataProcessing/RowEncoder.h"
+#include "DataProcessing/SyntheticData.h"
+#include <cstdio>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// lrp-score: scores rows with a saved RandomForest model, or with the library ForestCompiler built from it.
+// Rows are streamed from a CSV or binary column file (see SyntheticData.h) in batches; each batch is encoded and scored on the
+// shared thread pool while the next one is read, and its predictions are written before the next batch is scored, so memory
+// stays bounded by two batches whatever the input size.
+//
+// Usage: lrp-score --model <file> (--schema <file> | --train-csv <file> [--categorical 0,1]) [--input <file>|-] [--output <file>|-]
+//                  [--format csv|binary] [--batch-rows N] [--threads N] [--backend traversal|quickscorer|simd|quantized|compiled] [--compiled-library <file.so>]
+//                  [--probability leaf|vote] [--suggest] [--write-schema <file>] [--log-level debug|info|warning|error]
+//
+// Output is CSV: row,prediction,probability and, with --suggest (which needs --train-csv), the index of the closest paid back
+// training row sharing the row's categories and its numerical values, for rows predicted not to be fully paid.
+
+namespace {
+
+struct Options {
+    std::string model_path, schema_path, train_csv_path, input_path = "-", output_path = "-", write_schema_path;
+    std::string format = "csv";
+    std::vector<int> categorical = {0, 1};
+    size_t batch_rows = 8192;
+    size_t threads = 0;
+    ScoringBackend backend;
+    std::string library_path;
+    RandomForest::ProbabilityMode mode = RandomForest::LeafFrequency;
+    bool suggest = false;
+};
+
+/// @brief Rows read from the input, still unparsed for CSV.
+struct Batch {
+    std::vector<std::string> lines;
+    ColumnBlock block;
+    size_t rows = 0;
+};
+
+void usage(const char* program) {
+    std::cerr << "Usage: " << program << " --model <file> (--schema <file> | --train-csv <file> [--categorical 0,1]) [--input <file>|-] [--output <file>|-]"
+              << " [--format csv|binary] [--batch-rows N] [--threads N] [--backend traversal|quickscorer|simd|quantized|compiled] [--compiled-library <file.so>]"
+              << " [--probability leaf|vote] [--suggest] [--write-schema <file>] [--log-level debug|info|warning|error]" << std::endl;
+}
+
+/// @brief Fills @p batch with up to @p max_rows CSV lines. Returns false at the end of the input.
+bool read_csv_batch(std::istream& in, size_t max_rows, Batch& batch) {
+    batch.lines.resize(max_rows);
+    size_t rows = 0;
+    while (rows < max_rows && std::getline(in, batch.lines[rows])) {
+        if (!batch.lines[rows].empty() && batch.lines[rows].back() == '\r') batch.lines[rows].pop_back();
+        if (!batch.lines[rows].empty()) rows++;
+    }
+    batch.rows = rows;
+    return rows > 0;
+}
+
+/// @brief Per input column of a binary file: the schema column it feeds and what every category code means for it.
+struct BinaryBinding {
+    const RowEncoder::Column* column = nullptr;
+    bool categorical_input = false;
+    std::vector<int> code_output;       ///< Categorical schema column: output of every code, -1 for unknown categories.
+    std::vector<double> code_value;     ///< Numerical schema column fed by a categorical input column: value of every code.
+};
+
+std::vector<BinaryBinding> bind_binary(const RowEncoder& encoder, const BinaryColumnReader& reader) {
+    std::vector<BinaryBinding> bindings(reader.columns.size());
+    for (size_t input = 0; input < reader.columns.size(); input++) {
+        const BinaryColumnReader::Column& source = reader.columns[input];
+        int raw = encoder.find_column(source.name);
+        if (raw < 0) continue;
+        BinaryBinding& binding = bindings[input];
+        binding.column = &encoder.get_columns()[raw];
+        binding.categorical_input = source.categorical;
+        for (const std::string& category : source.categories) {
+            if (binding.column->categorical) {
+                auto it = binding.column->categories.find(category);
+                binding.code_output.push_back(it == binding.column->categories.end() ? -1 : it->second);
+            } else {
+                binding.code_value.push_back(RowEncoder::parse(category));
+            }
+        }
+    }
+    return bindings;
+}
+
+void encode_binary_row(const RowEncoder& encoder, const std::vector<BinaryBinding>& bindings, const ColumnBlock& block, size_t row, double* out) {
+    encoder.reset(out);
+    for (size_t input = 0; input < bindings.size(); input++) {
+        const BinaryBinding& binding = bindings[input];
+        if (!binding.column) continue;
+        double cell = block.columns[input][row];
+        if (!binding.categorical_input) {
+            if (!binding.column->categorical) encoder.set_numeric(*binding.column, cell, out);
+            continue;
+        }
+        if (cell < 0) continue;
+        size_t code = static_cast<size_t>(cell);
+        if (binding.column->categorical) encoder.set_category(*binding.column, binding.code_output[code], out);
+        else encoder.set_numeric(*binding.column, binding.code_value[code], out);
+    }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    LogLevel log_level = LogLevel::Warning;
+    try {
+        for (int i = 1; i < argc; i++) {
+            std::string flag = argv[i];
+            if (flag == "--suggest") {
+                options.suggest = true;
+                continue;
+            }
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+                return 1;
+            }
+            std::string value = argv[++i];
+            if (flag == "--model") options.model_path = value;
+            else if (flag == "--schema") options.schema_path = value;
+            else if (flag == "--train-csv") options.train_csv_path = value;
+            else if (flag == "--categorical") options.categorical = parse_index_list(value);
+            else if (flag == "--input") options.input_path = value;
+            else if (flag == "--output") options.output_path = value;
+            else if (flag == "--write-schema") options.write_schema_path = value;
+            else if (flag == "--format") options.format = value;
+            else if (flag == "--batch-rows") options.batch_rows = std::stoul(value);
+            else if (flag == "--threads") options.threads = std::stoul(value);
+            else if (flag == "--backend") options.backend = parse_scoring_backend(value);
+            else if (flag == "--compiled-library") options.library_path = value;
+            else if (flag == "--probability") options.mode = parse_probability_mode(value);
+            else if (flag == "--log-level") log_level = parse_log_level(value);
+            else {
+                std::cerr << "Unknown option: " << flag << std::endl;
+                usage(argv[0]);
+                return 1;
+            }
+        }
+        if (options.model_path.empty() || (options.schema_path.empty() == options.train_csv_path.empty())) {
+            usage(argv[0]);
+            return 1;
+        }
+        if (options.suggest && options.train_csv_path.empty()) throw std::invalid_argument("--suggest needs --train-csv.");
+        if (options.format != "csv" && options.format != "binary") throw std::invalid_argument("Unknown format: " + options.format);
+        if (options.batch_rows == 0) throw std::invalid_argument("--batch-rows must be positive.");
+        Logger::global().set_level(log_level);
+
+        // the schema comes from a saved file or from the training CSV, which --suggest also searches
+        std::unique_ptr<DataFrame> frame;
+        RowEncoder encoder;
+        if (!options.train_csv_path.empty()) {
+            std::ifstream train_csv(options.train_csv_path);
+            if (!train_csv) throw std::runtime_error("Cannot open " + options.train_csv_path);
+            DataHandler handler;
+            frame.reset(handler.process_data(train_csv, options.categorical));
+            encoder = RowEncoder(*frame);
+        } else {
+            std::ifstream schema(options.schema_path);
+            if (!schema) throw std::runtime_error("Cannot open " + options.schema_path);
+            encoder = RowEncoder::load(schema);
+        }
+        if (!options.write_schema_path.empty()) {
+            std::ofstream schema(options.write_schema_path);
+            encoder.save(schema);
+        }
+
+        RandomForest forest(0);
+        forest.load(options.model_path, options.backend.compiled ? RandomForest::TraversalBackend : options.backend.engine);
+        // a schema or --categorical set that does not match the model would leave the rows short of the features it reads
+        forest.require_features(encoder.num_features());
+        // with --backend compiled the library built by ForestCompiler scores the rows; the model vouches for it
+        std::unique_ptr<CompiledForest> compiled;
+        if (options.backend.compiled) {
+            if (options.library_path.empty()) throw std::invalid_argument("--backend compiled needs --compiled-library.");
+            compiled.reset(new CompiledForest(options.library_path));
+            compiled->check_compiled_from(forest);
+        }
+
+        std::ifstream input_file;
+        std::istream* input = &std::cin;
+        if (options.input_path != "-") {
+            input_file.open(options.input_path, std::ios::binary);
+            if (!input_file) throw std::runtime_error("Cannot open " + options.input_path);
+            input = &input_file;
+        }
+        std::ofstream output_file;
+        std::ostream* output = &std::cout;
+        std::ios::sync_with_stdio(false);
+        if (options.output_path != "-") {
+            output_file.open(options.output_path);
+            if (!output_file) throw std::runtime_error("Cannot write " + options.output_path);
+            output = &output_file;
+        }
+
+        bool binary = options.format == "binary";
+        std::unique_ptr<BinaryColumnReader> reader;
+        std::vector<BinaryBinding> bindings;
+        if (binary) {
+            reader.reset(new BinaryColumnReader(*input));
+            bindings = bind_binary(encoder, *reader);
+        } else {
+            std::string header;
+            if (!std::getline(*input, header)) throw std::runtime_error("Input has no header row.");
+            if (!header.empty() && header.back() == '\r') header.pop_back();
+            encoder.bind(DatasetProfile::split(header));
+        }
+
+        std::vector<int> suggestion_columns;
+        *output << "row,prediction,probability";
+        if (options.suggest) {
+            suggestion_columns = frame->get_all_numerical_columns();
+            suggestion_columns.pop_back();          // the label
+            *output << ",suggested_row";
+            for (int col : suggestion_columns) *output << ",suggested." << frame->get_feature_name_from_col_index(col);
+        }
+        *output << "\n";
+
+        auto read_batch = [&](Batch& batch) {
+            if (binary) {
+                bool more = reader->next_block(batch.block);
+                batch.rows = more ? batch.block.rows : 0;
+                return more;
+            }
+            return read_csv_batch(*input, options.batch_rows, batch);
+        };
+
+        ThreadPool& pool = ThreadPool::global();
+        const size_t chunk_rows = 256;
+        const size_t num_features = encoder.num_features();
+        std::vector<std::vector<double>> rows;
+        std::vector<RandomForest::ForestScore> scores;
+        std::vector<std::string> chunks;
+        SuggestionGenerator generator;
+        Batch batches[2];
+        bool more = read_batch(batches[0]);
+        uint64_t first_row = 0;
+        for (size_t current = 0; more; current ^= 1) {
+            Batch& batch = batches[current];
+            // read the next batch while this one is scored
+            std::future<bool> next = std::async(std::launch::async, read_batch, std::ref(batches[current ^ 1]));
+
+            const size_t count = batch.rows;
+            const size_t num_chunks = (count + chunk_rows - 1) / chunk_rows;
+            rows.resize(count);
+            pool.parallel_for(num_chunks, [&](size_t c) {
+                std::vector<std::string> cells;
+                for (size_t i = c * chunk_rows; i < std::min(count, (c + 1) * chunk_rows); i++) {
+                    rows[i].resize(num_features);
+                    if (binary) {
+                        encode_binary_row(encoder, bindings, batch.block, i, rows[i].data());
+                    } else {
+                        cells = DatasetProfile::split(batch.lines[i]);
+                        encoder.encode(cells, rows[i].data());
+                    }
+                }
+            }, options.threads);
+
+            if (compiled) compiled->score_batch(rows, scores, options.threads);
+            else forest.score_batch(rows, scores, options.threads);
+
+            chunks.resize(num_chunks);
+            pool.parallel_for(num_chunks, [&](size_t c) {
+                std::string& text = chunks[c];
+                text.clear();
+                char line[96];
+                std::vector<double> point;
+                for (size_t i = c * chunk_rows; i < std::min(count, (c + 1) * chunk_rows); i++) {
+                    int prediction = scores[i].prediction();
+                    std::snprintf(line, sizeof(line), "%llu,%d,%.6f", static_cast<unsigned long long>(first_row + i), prediction, scores[i].probability(options.mode));
+                    text += line;
+                    if (options.suggest) {
+                        int suggested = -1;
+                        if (prediction == 1) {
+                            point.assign(rows[i].begin(), rows[i].end());
+                            point.push_back(0.0);           // label slot, the frame's rows carry one
+                            suggested = generator.get_closest_positive_row(point, frame.get());
+                        }
+                        text += "," + (suggested < 0 ? std::string() : std::to_string(suggested));
+                        for (int col : suggestion_columns) {
+                            text += ',';
+                            if (suggested >= 0) {
+                                std::snprintf(line, sizeof(line), "%.10g", frame->get_data_vec()[suggested][col]);
+                                text += line;
+                            }
+                        }
+                    }
+                    text += '\n';
+                }
+            }, options.threads);
+            for (const std::string& text : chunks) output->write(text.data(), text.size());
+            first_row += count;
+            more = next.get();
+        }
+        output->flush();
+        Logger::global().flush();
+        if (!*output) {
+            std::cerr << "Error writing output" << std::endl;
+            return 1;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,566 @@
+#include "CoreLogic/RandomForest.h"
+#include "CoreLogic/CompiledForest.h"
+#include "CoreLogic/SuggestionGenerator.h"
+#include "Includes/CommandLine.h"
+#include "DataProcessing/DataHandler.h"
+#include "DataProcessing/RowEncoder.h"
+#include "Includes/MicroBatcher.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <atomic>
+#include <cctype>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// lrp-serve: keeps a saved RandomForest, its schema and optionally the suggestion index resident, and scores rows sent over a
+// Unix domain socket (and optionally localhost TCP). Every connection may send many requests; requests from all connections
+// are coalesced into micro-batches for the batch predictor (see MicroBatcher.h). A connection waits for each answer before
+// scoring its next request, so requests pipelined on one connection are never batched together: batches only form across
+// concurrent connections, and a client wanting throughput opens several.
+//
+// Usage: lrp-serve --model <file> (--schema <file> | --train-csv <file> [--categorical 0,1]) [--socket <path>] [--tcp-port N]
+//                  [--backend traversal|quickscorer|simd|quantized|compiled] [--compiled-library <file.so>] [--probability leaf|vote] [--suggest] [--max-batch N]
+//                  [--max-wait-us N] [--threads N] [--stats-interval S] [--log-level debug|info|warning|error]
+//
+// Requests, answered in order on the same connection:
+//   JSON, one object per line: {"id": 7, "loan_amnt": 5000, "purpose": "car"}. Keys are raw column names of the schema,
+//   missing columns are imputed, "id" (a number or a string) is echoed back. Answer: {"id":7,"prediction":0,"probability":0.123456}, plus
+//   "suggested_row" and "suggestion" with --suggest for rows predicted not to be fully paid. {"cmd":"stats"} returns the
+//   request count, batch sizes and p50/p99/p99.9 latency in microseconds; {"cmd":"ping"} returns {"ok":true}.
+//   Binary: byte 0x02, a uint32 feature count, then that many float64 features already encoded as the schema's one-hot
+//   layout, all native byte order. Answer: byte 0x02, a uint8 prediction and a float64 probability.
+// A JSON line longer than 1 MiB gets an error and the connection is closed.
+// Latency is measured from a complete request in the buffer to its answer written to the socket. Requests that arrived
+// together are answered with one write, so each is timed up to that write.
+
+namespace {
+
+const unsigned char kBinaryRequest = 0x02;
+
+/// Longest JSON request line; a client that sends more without a newline is disconnected, so buffers stay bounded.
+const size_t kMaxLineBytes = 1 << 20;
+
+std::atomic<bool> stop_requested(false);
+
+void handle_signal(int) { stop_requested = true; }
+
+struct Options {
+    std::string model_path, schema_path, train_csv_path, socket_path = "/tmp/lrp-serve.sock";
+    std::vector<int> categorical = {0, 1};
+    int tcp_port = 0;
+    size_t max_batch = 256;
+    long max_wait_us = 0;
+    size_t threads = 1;
+    double stats_interval = 0.0;
+    ScoringBackend backend;
+    std::string library_path;
+    RandomForest::ProbabilityMode mode = RandomForest::LeafFrequency;
+    bool suggest = false;
+};
+
+void usage(const char* program) {
+    std::cerr << "Usage: " << program << " --model <file> (--schema <file> | --train-csv <file> [--categorical 0,1]) [--socket <path>] [--tcp-port N]"
+              << " [--backend traversal|quickscorer|simd|quantized|compiled] [--compiled-library <file.so>] [--probability leaf|vote] [--suggest] [--max-batch N]"
+              << " [--max-wait-us N] [--threads N] [--stats-interval S] [--log-level debug|info|warning|error]" << std::endl;
+}
+
+/// @brief One member of a flat JSON object. Numbers, booleans and null keep their literal text.
+struct JsonField {
+    std::string key;
+    std::string value;
+    bool is_string = false;
+};
+
+/// @brief Parses a JSON string starting at the opening quote, leaving @p pos after the closing one.
+bool parse_json_string(const std::string& text, size_t& pos, std::string& out) {
+    out.clear();
+    for (pos++; pos < text.size(); pos++) {
+        char c = text[pos];
+        if (c == '"') {
+            pos++;
+            return true;
+        }
+        if (c != '\\') {
+            out += c;
+            continue;
+        }
+        if (++pos >= text.size()) return false;
+        switch (text[pos]) {
+            case 'n': out += '\n'; break;
+            case 't': out += '\t'; break;
+            case 'r': out += '\r'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'u': {
+                if (pos + 4 >= text.size()) return false;
+                char* end = nullptr;
+                std::string hex = text.substr(pos + 1, 4);
+                unsigned long code = std::strtoul(hex.c_str(), &end, 16);
+                if (end != hex.c_str() + 4) return false;
+                pos += 4;
+                // surrogate pairs are not combined, names and categories outside the basic plane are not expected
+                if (code < 0x80) out += static_cast<char>(code);
+                else if (code < 0x800) {
+                    out += static_cast<char>(0xC0 | (code >> 6));
+                    out += static_cast<char>(0x80 | (code & 0x3F));
+                } else {
+                    out += static_cast<char>(0xE0 | (code >> 12));
+                    out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                    out += static_cast<char>(0x80 | (code & 0x3F));
+                }
+                break;
+            }
+            default: out += text[pos];
+        }
+    }
+    return false;
+}
+
+/// @brief Parses a flat JSON object: string keys, scalar values. Nested objects and arrays are rejected.
+bool parse_flat_json(const std::string& text, std::vector<JsonField>& fields) {
+    fields.clear();
+    size_t pos = 0;
+    auto skip_space = [&] { while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) pos++; };
+    skip_space();
+    if (pos >= text.size() || text[pos++] != '{') return false;
+    skip_space();
+    if (pos < text.size() && text[pos] == '}') return true;
+    while (pos < text.size()) {
+        JsonField field;
+        skip_space();
+        if (pos >= text.size() || text[pos] != '"' || !parse_json_string(text, pos, field.key)) return false;
+        skip_space();
+        if (pos >= text.size() || text[pos++] != ':') return false;
+        skip_space();
+        if (pos >= text.size()) return false;
+        if (text[pos] == '"') {
+            if (!parse_json_string(text, pos, field.value)) return false;
+            field.is_string = true;
+        } else {
+            size_t start = pos;
+            while (pos < text.size() && text[pos] != ',' && text[pos] != '}' && !std::isspace(static_cast<unsigned char>(text[pos]))) pos++;
+            field.value = text.substr(start, pos - start);
+            if (field.value.empty() || field.value[0] == '{' || field.value[0] == '[') return false;
+        }
+        fields.push_back(field);
+        skip_space();
+        if (pos >= text.size()) return false;
+        if (text[pos] == '}') return true;
+        if (text[pos++] != ',') return false;
+    }
+    return false;
+}
+
+/// @brief Whether @p text is a JSON number literal, such as -12, 0.5 or 1e3.
+bool is_json_number(const std::string& text) {
+    size_t pos = 0;
+    auto digits = [&] {
+        size_t start = pos;
+        while (pos < text.size() && std::isdigit(static_cast<unsigned char>(text[pos]))) pos++;
+        return pos > start;
+    };
+    if (pos < text.size() && text[pos] == '-') pos++;
+    if (pos < text.size() && text[pos] == '0') pos++;
+    else if (!digits()) return false;
+    if (pos < text.size() && text[pos] == '.') {
+        pos++;
+        if (!digits()) return false;
+    }
+    if (pos < text.size() && (text[pos] == 'e' || text[pos] == 'E')) {
+        pos++;
+        if (pos < text.size() && (text[pos] == '+' || text[pos] == '-')) pos++;
+        if (!digits()) return false;
+    }
+    return pos == text.size();
+}
+
+void append_json_string(std::string& out, const std::string& value) {
+    out += '"';
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+/// @brief Everything the connections share.
+class Server {
+public:
+    /// @param compiled Scores the rows instead of @p forest when given (--backend compiled).
+    Server(const Options& options, RandomForest& forest, const CompiledForest* compiled, RowEncoder& encoder, DataFrame* frame)
+        : options(options), forest(forest), compiled(compiled), encoder(encoder), frame(frame),
+          batcher([this](const std::vector<std::vector<double>>& rows, std::vector<RandomForest::ForestScore>& scores) {
+                      if (this->compiled) this->compiled->score_batch(rows, scores, this->options.threads);
+                      else this->forest.score_batch(rows, scores, this->options.threads);
+                  },
+                  options.max_batch, std::chrono::microseconds(options.max_wait_us)) {
+        if (frame && options.suggest) {
+            suggestion_columns = frame->get_all_numerical_columns();
+            suggestion_columns.pop_back();          // the label
+        }
+    }
+
+    /// @brief Serves one connection until the peer closes it or the server stops. The caller closes @p fd.
+    /// Requests are scored one after the other, each in whatever batch the other connections are forming.
+    void serve(int fd) {
+        std::string buffer;
+        std::string reply;
+        std::vector<std::chrono::steady_clock::time_point> timed;   // starts of the scored requests answered in reply
+        std::vector<JsonField> fields;
+        SuggestionGenerator generator;
+        char chunk[65536];
+        size_t consumed = 0;
+        while (true) {
+            ssize_t received = recv(fd, chunk, sizeof(chunk), 0);
+            if (received <= 0) break;
+            buffer.append(chunk, received);
+            // answer every complete request in the buffer, in order
+            reply.clear();
+            timed.clear();
+            bool close_connection = false;
+            while (consumed < buffer.size()) {
+                auto start = std::chrono::steady_clock::now();
+                if (static_cast<unsigned char>(buffer[consumed]) == kBinaryRequest) {
+                    if (buffer.size() - consumed < 5) break;
+                    uint32_t count;
+                    std::memcpy(&count, buffer.data() + consumed + 1, sizeof(count));
+                    if (count != encoder.num_features()) {
+                        reply += "{\"error\":\"binary request has " + std::to_string(count) + " features, the model reads " + std::to_string(encoder.num_features()) + "\"}\n";
+                        close_connection = true;
+                        break;
+                    }
+                    size_t size = 5 + count * sizeof(double);
+                    if (buffer.size() - consumed < size) break;
+                    std::vector<double> row(count);
+                    std::memcpy(row.data(), buffer.data() + consumed + 5, count * sizeof(double));
+                    consumed += size;
+                    RandomForest::ForestScore score = batcher.submit(std::move(row));
+                    double probability = score.probability(options.mode);
+                    char answer[1 + 1 + sizeof(double)];
+                    answer[0] = kBinaryRequest;
+                    answer[1] = score.prediction();
+                    std::memcpy(answer + 2, &probability, sizeof(double));
+                    reply.append(answer, sizeof(answer));
+                    timed.push_back(start);
+                } else {
+                    size_t end = buffer.find('\n', consumed);
+                    if (end == std::string::npos) {
+                        if (buffer.size() - consumed > kMaxLineBytes) {
+                            reply += "{\"error\":\"request line longer than " + std::to_string(kMaxLineBytes) + " bytes\"}\n";
+                            close_connection = true;
+                        }
+                        break;
+                    }
+                    std::string line = buffer.substr(consumed, end - consumed);
+                    consumed = end + 1;
+                    if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+                    if (answer_json(line, fields, generator, reply)) timed.push_back(start);
+                }
+            }
+            if (!reply.empty() && !send_all(fd, reply)) break;
+            auto sent = std::chrono::steady_clock::now();
+            for (auto start : timed) latencies.record(sent - start);
+            if (close_connection) break;
+            // keep the unanswered tail only
+            if (consumed > 0) {
+                buffer.erase(0, consumed);
+                consumed = 0;
+            }
+        }
+    }
+
+    std::string stats_json() const {
+        uint64_t batches = batcher.batch_count();
+        char text[512];
+        std::snprintf(text, sizeof(text),
+                      "{\"requests\":%llu,\"rows_scored\":%llu,\"batches\":%llu,\"mean_batch\":%.2f,\"largest_batch\":%zu,"
+                      "\"p50_us\":%.1f,\"p99_us\":%.1f,\"p999_us\":%.1f,\"mean_us\":%.1f,\"max_us\":%.1f}",
+                      static_cast<unsigned long long>(latencies.count()), static_cast<unsigned long long>(batcher.row_count()),
+                      static_cast<unsigned long long>(batches), batches == 0 ? 0.0 : batcher.row_count() / static_cast<double>(batches),
+                      batcher.largest_batch(), latencies.percentile(50), latencies.percentile(99), latencies.percentile(99.9),
+                      latencies.mean(), latencies.max());
+        return text;
+    }
+
+private:
+    /// @return True if the request was a row to score, false for commands and malformed requests, which are not timed.
+    bool answer_json(const std::string& line, std::vector<JsonField>& fields, SuggestionGenerator& generator, std::string& reply) {
+        if (!parse_flat_json(line, fields)) {
+            reply += "{\"error\":\"expected a flat JSON object\"}\n";
+            return false;
+        }
+        std::string id;
+        for (const JsonField& field : fields) {
+            if (field.key != "id") continue;
+            // echoed verbatim, so anything but a string or a number literal would make the answer invalid JSON
+            if (field.is_string) append_json_string(id, field.value);
+            else if (is_json_number(field.value)) id = field.value;
+            else {
+                reply += "{\"error\":\"id must be a number or a string\"}\n";
+                return false;
+            }
+        }
+        std::string prefix = id.empty() ? "{" : "{\"id\":" + id + ",";
+        for (const JsonField& field : fields) {
+            if (field.key != "cmd") continue;
+            if (field.value == "stats") reply += stats_json() + "\n";
+            else if (field.value == "ping") reply += prefix + "\"ok\":true}\n";
+            else reply += prefix + "\"error\":\"unknown command\"}\n";
+            return false;
+        }
+
+        std::vector<double> row(encoder.num_features());
+        encoder.reset(row.data());
+        for (const JsonField& field : fields) {
+            int index = encoder.find_column(field.key);
+            if (index < 0) continue;
+            const RowEncoder::Column& column = encoder.get_columns()[index];
+            if (column.categorical) {
+                auto category = column.categories.find(field.value);
+                if (category != column.categories.end()) encoder.set_category(column, category->second, row.data());
+            } else if (!field.is_string && (field.value == "true" || field.value == "false")) {
+                encoder.set_numeric(column, field.value == "true" ? 1.0 : 0.0, row.data());
+            } else {
+                encoder.set_numeric(column, RowEncoder::parse(field.value), row.data());     // null and non-numbers are NaN, imputed
+            }
+        }
+        std::vector<double> point;
+        if (!suggestion_columns.empty()) point = row;
+        RandomForest::ForestScore score = batcher.submit(std::move(row));
+        int prediction = score.prediction();
+        char text[96];
+        std::snprintf(text, sizeof(text), "\"prediction\":%d,\"probability\":%.6f", prediction, score.probability(options.mode));
+        reply += prefix + text;
+        if (!suggestion_columns.empty() && prediction == 1) {
+            point.push_back(0.0);               // label slot, the frame's rows carry one
+            int suggested = generator.get_closest_positive_row(point, frame);
+            if (suggested >= 0) {
+                reply += ",\"suggested_row\":" + std::to_string(suggested) + ",\"suggestion\":{";
+                for (size_t i = 0; i < suggestion_columns.size(); i++) {
+                    if (i > 0) reply += ',';
+                    append_json_string(reply, frame->get_feature_name_from_col_index(suggestion_columns[i]));
+                    std::snprintf(text, sizeof(text), ":%.10g", frame->get_data_vec()[suggested][suggestion_columns[i]]);
+                    reply += text;
+                }
+                reply += '}';
+            }
+        }
+        reply += "}\n";
+        return true;
+    }
+
+    static bool send_all(int fd, const std::string& data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t written = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (written <= 0) return false;
+            sent += written;
+        }
+        return true;
+    }
+
+    const Options& options;
+    RandomForest& forest;
+    const CompiledForest* compiled;
+    RowEncoder& encoder;
+    DataFrame* frame;
+    std::vector<int> suggestion_columns;
+    LatencyRecorder latencies;
+    MicroBatcher<RandomForest::ForestScore> batcher;
+};
+
+/// @brief A client connection and the thread serving it. The socket is closed once the thread is joined.
+struct Connection {
+    int fd = -1;
+    std::thread thread;
+    std::atomic<bool> finished{false};
+};
+
+int listen_unix(const std::string& path) {
+    sockaddr_un address{};
+    if (path.size() >= sizeof(address.sun_path)) throw std::invalid_argument("Socket path too long: " + path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) throw std::runtime_error("Cannot create a Unix socket");
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, path.c_str());
+    unlink(path.c_str());
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(fd, 128) < 0) {
+        close(fd);
+        throw std::runtime_error("Cannot listen on " + path + ": " + std::strerror(errno));
+    }
+    return fd;
+}
+
+int listen_tcp(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) throw std::runtime_error("Cannot create a TCP socket");
+    int enable = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);         // localhost only, there is no authentication
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(fd, 128) < 0) {
+        close(fd);
+        throw std::runtime_error("Cannot listen on 127.0.0.1:" + std::to_string(port) + ": " + std::strerror(errno));
+    }
+    return fd;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    LogLevel log_level = LogLevel::Info;
+    try {
+        for (int i = 1; i < argc; i++) {
+            std::string flag = argv[i];
+            if (flag == "--suggest") {
+                options.suggest = true;
+                continue;
+            }
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+                return 1;
+            }
+            std::string value = argv[++i];
+            if (flag == "--model") options.model_path = value;
+            else if (flag == "--schema") options.schema_path = value;
+            else if (flag == "--train-csv") options.train_csv_path = value;
+            else if (flag == "--categorical") options.categorical = parse_index_list(value);
+            else if (flag == "--socket") options.socket_path = value;
+            else if (flag == "--tcp-port") options.tcp_port = std::stoi(value);
+            else if (flag == "--max-batch") options.max_batch = std::stoul(value);
+            else if (flag == "--max-wait-us") options.max_wait_us = std::stol(value);
+            else if (flag == "--threads") options.threads = std::stoul(value);
+            else if (flag == "--stats-interval") options.stats_interval = std::stod(value);
+            else if (flag == "--backend") options.backend = parse_scoring_backend(value);
+            else if (flag == "--compiled-library") options.library_path = value;
+            else if (flag == "--probability") options.mode = parse_probability_mode(value);
+            else if (flag == "--log-level") log_level = parse_log_level(value);
+            else {
+                std::cerr << "Unknown option: " << flag << std::endl;
+                usage(argv[0]);
+                return 1;
+            }
+        }
+        if (options.model_path.empty() || (options.schema_path.empty() == options.train_csv_path.empty())) {
+            usage(argv[0]);
+            return 1;
+        }
+        if (options.suggest && options.train_csv_path.empty()) throw std::invalid_argument("--suggest needs --train-csv.");
+        Logger::global().set_level(log_level);
+
+        std::unique_ptr<DataFrame> frame;
+        RowEncoder encoder;
+        if (!options.train_csv_path.empty()) {
+            std::ifstream train_csv(options.train_csv_path);
+            if (!train_csv) throw std::runtime_error("Cannot open " + options.train_csv_path);
+            DataHandler handler;
+            frame.reset(handler.process_data(train_csv, options.categorical));
+            encoder = RowEncoder(*frame);
+        } else {
+            std::ifstream schema(options.schema_path);
+            if (!schema) throw std::runtime_error("Cannot open " + options.schema_path);
+            encoder = RowEncoder::load(schema);
+        }
+        RandomForest forest(0);
+        forest.load(options.model_path, options.backend.compiled ? RandomForest::TraversalBackend : options.backend.engine);
+        // a schema or --categorical set that does not match the model would leave the rows short of the features it reads
+        forest.require_features(encoder.num_features());
+        // with --backend compiled the library built by ForestCompiler scores the rows; the model vouches for it
+        std::unique_ptr<CompiledForest> compiled;
+        if (options.backend.compiled) {
+            if (options.library_path.empty()) throw std::invalid_argument("--backend compiled needs --compiled-library.");
+            compiled.reset(new CompiledForest(options.library_path));
+            compiled->check_compiled_from(forest);
+        }
+
+        std::signal(SIGINT, handle_signal);
+        std::signal(SIGTERM, handle_signal);
+        std::signal(SIGPIPE, SIG_IGN);
+
+        Server server(options, forest, compiled.get(), encoder, frame.get());
+        std::vector<pollfd> listeners;
+        listeners.push_back({listen_unix(options.socket_path), POLLIN, 0});
+        if (options.tcp_port > 0) listeners.push_back({listen_tcp(options.tcp_port), POLLIN, 0});
+        LRP_LOG_INFO("serve.start", "Serving " << forest.get_trees().size() << " trees on " << options.socket_path
+                     << (options.tcp_port > 0 ? " and 127.0.0.1:" + std::to_string(options.tcp_port) : std::string()));
+
+        // one thread per connection; clients are expected to keep their connection open for many requests
+        std::list<Connection> connections;
+        auto reap = [&connections](bool all) {
+            for (auto it = connections.begin(); it != connections.end();) {
+                if (!all && !it->finished) {
+                    ++it;
+                    continue;
+                }
+                it->thread.join();
+                close(it->fd);
+                it = connections.erase(it);
+            }
+        };
+        auto last_stats = std::chrono::steady_clock::now();
+        while (!stop_requested) {
+            // a short timeout, so signals and the stats interval are noticed
+            int ready = poll(listeners.data(), listeners.size(), 200);
+            if (ready < 0 && errno != EINTR) throw std::runtime_error(std::string("poll failed: ") + std::strerror(errno));
+            for (size_t l = 0; ready > 0 && l < listeners.size(); l++) {
+                if (!(listeners[l].revents & POLLIN)) continue;
+                int fd = accept(listeners[l].fd, nullptr, nullptr);
+                if (fd < 0) continue;
+                if (l > 0) {
+                    int enable = 1;
+                    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+                }
+                connections.emplace_back();
+                Connection& connection = connections.back();
+                connection.fd = fd;
+                connection.thread = std::thread([&server, &connection] {
+                    server.serve(connection.fd);
+                    connection.finished = true;
+                });
+            }
+            reap(false);
+            if (options.stats_interval > 0 && std::chrono::steady_clock::now() - last_stats >= std::chrono::duration<double>(options.stats_interval)) {
+                LRP_LOG_INFO("serve.stats", server.stats_json());
+                last_stats = std::chrono::steady_clock::now();
+            }
+        }
+
+        for (const pollfd& listener : listeners) close(listener.fd);
+        unlink(options.socket_path.c_str());
+        // wake the connections blocked in recv
+        for (Connection& connection : connections) shutdown(connection.fd, SHUT_RDWR);
+        reap(true);
+        std::cerr << server.stats_json() << std::endl;
+        Logger::global().flush();
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
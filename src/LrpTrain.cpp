@@ -0,0 +1,207 @@
+#include "CoreLogic/RandomForest.h"
+#include "CoreLogic/ExtraTrees.h"
+#include "CoreLogic/FeatureImportance.h"
+#include "CoreLogic/Metrics.h"
+#include "Includes/CommandLine.h"
+#include "DataProcessing/DataHandler.h"
+#include "DataProcessing/RowEncoder.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <memory>
+#include <string>
+#include <vector>
+
+// lrp-train: trains a RandomForest on a CSV and writes the model and its RowEncoder schema for lrp-score.
+// The seed drives the validation split, the bootstrap samples and every tree, so a fixed seed gives a bit-identical model
+// whatever the thread count. --importance-out writes the impurity importance of every feature and, with a holdout, its
+// permutation importance on the holdout rows. --metrics-out writes the full holdout report with its calibration table.
+//
+// Usage: lrp-train --data <csv> --model <file> [--schema <file>] [--categorical 0,1] [--trees N] [--max-depth N]
+//                  [--min-samples-split N] [--min-samples-leaf N] [--max-leaf-nodes N] [--min-impurity-decrease X]
+//                  [--max-features all|sqrt|log2|<fraction>|<count>] [--split best|random] [--no-bootstrap] [--threads N]
+//                  [--max-bins N] [--seed N] [--validation none|holdout[:<fraction>]|kfold:<k>] [--huge-pages]
+//                  [--metrics-out <file>] [--importance-out <file>] [--importance-repeats N] [--instrumentation-out <file>] [--log-level debug|info|warning|error]
+
+namespace {
+
+void usage(const char* program) {
+    std::cerr << "Usage: " << program << " --data <csv> --model <file> [--schema <file>] [--categorical 0,1] [--trees N] [--max-depth N]"
+              << " [--min-samples-split N] [--min-samples-leaf N] [--max-leaf-nodes N] [--min-impurity-decrease X]"
+              << " [--max-features all|sqrt|log2|<fraction>|<count>] [--split best|random] [--no-bootstrap] [--threads N]"
+              << " [--max-bins N] [--seed N] [--validation none|holdout[:<fraction>]|kfold:<k>] [--huge-pages]"
+              << " [--metrics-out <file>] [--importance-out <file>] [--importance-repeats N] [--instrumentation-out <file>] [--log-level debug|info|warning|error]" << std::endl;
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    std::string data_path, model_path, schema_path, validation = "holdout", instrumentation_path, importance_path, metrics_path;
+    std::vector<int> categorical = {0, 1};
+    int num_trees = 100, importance_repeats = 5;
+    unsigned int seed = 42;
+    bool bootstrap = true;
+    TreeOptions options = RandomForest::default_tree_options();
+    LogLevel log_level = LogLevel::Warning;
+    try {
+        for (int i = 1; i < argc; i++) {
+            std::string flag = argv[i];
+            if (flag == "--no-bootstrap") {
+                bootstrap = false;
+                continue;
+            }
+            if (flag == "--huge-pages") {
+                options.huge_pages = true;
+                continue;
+            }
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+                return 1;
+            }
+            std::string value = argv[++i];
+            if (flag == "--data") data_path = value;
+            else if (flag == "--model") model_path = value;
+            else if (flag == "--schema") schema_path = value;
+            else if (flag == "--categorical") categorical = parse_index_list(value);
+            else if (flag == "--trees") num_trees = std::stoi(value);
+            else if (flag == "--max-depth") options.max_depth = std::stoi(value);
+            else if (flag == "--min-samples-split") options.min_samples_split = std::stoul(value);
+            else if (flag == "--min-samples-leaf") options.min_samples_leaf = std::stoul(value);
+            else if (flag == "--max-leaf-nodes") options.max_leaf_nodes = std::stoi(value);
+            else if (flag == "--min-impurity-decrease") options.min_impurity_decrease = std::stod(value);
+            else if (flag == "--max-features") options.max_features = MaxFeatures::parse(value);
+            else if (flag == "--split") {
+                if (value == "best") options.split_mode = BestSplit;
+                else if (value == "random") options.split_mode = RandomSplit;
+                else throw std::invalid_argument("Unknown split mode: " + value);
+            }
+            else if (flag == "--threads") options.num_threads = std::stoul(value);
+            else if (flag == "--max-bins") options.max_bins = std::stoi(value);
+            else if (flag == "--seed") seed = static_cast<unsigned int>(std::stoul(value));
+            else if (flag == "--validation") validation = value;
+            else if (flag == "--instrumentation-out") instrumentation_path = value;
+            else if (flag == "--metrics-out") metrics_path = value;
+            else if (flag == "--importance-out") importance_path = value;
+            else if (flag == "--importance-repeats") importance_repeats = std::stoi(value);
+            else if (flag == "--log-level") log_level = parse_log_level(value);
+            else {
+                std::cerr << "Unknown option: " << flag << std::endl;
+                usage(argv[0]);
+                return 1;
+            }
+        }
+        if (data_path.empty() || model_path.empty() || num_trees <= 0) {
+            usage(argv[0]);
+            return 1;
+        }
+        if (schema_path.empty()) schema_path = model_path + ".schema";
+        double holdout = 0.0;
+        int folds = 0;
+        if (validation == "holdout") holdout = 0.2;
+        else if (validation.rfind("holdout:", 0) == 0) holdout = std::stod(validation.substr(8));
+        else if (validation.rfind("kfold:", 0) == 0) folds = std::stoi(validation.substr(6));
+        else if (validation != "none") throw std::invalid_argument("Unknown validation mode: " + validation);
+        if (holdout < 0 || holdout >= 1 || (validation.rfind("kfold:", 0) == 0 && folds < 2)) throw std::invalid_argument("Invalid validation mode: " + validation);
+        Logger::global().set_level(log_level);
+        Instrumentation::global().reset();
+
+        auto start = std::chrono::steady_clock::now();
+        std::ifstream csv(data_path);
+        if (!csv) throw std::runtime_error("Cannot open " + data_path);
+        DataHandler handler;
+        std::unique_ptr<DataFrame> frame(handler.process_data(csv, categorical));
+        const std::vector<std::vector<double>>& data = frame->get_data_vec();
+        if (data.empty()) throw std::runtime_error("No rows in " + data_path);
+        double load_seconds = seconds_since(start);
+        std::cout << "Loaded " << data.size() << " rows x " << data[0].size() - 1 << " features in " << load_seconds << " s" << std::endl;
+
+        // ExtraTrees is the same forest with random splits and no bootstrap
+        std::unique_ptr<RandomForest> forest(options.split_mode == RandomSplit ? new ExtraTrees(num_trees, options) : new RandomForest(num_trees, options));
+        if (!bootstrap) forest->set_bootstrap(false);
+        forest->set_holdout_fraction(0.0);
+
+        if (folds > 0) {
+            start = std::chrono::steady_clock::now();
+            forest->set_seed(seed);
+            double accuracy = forest->kFoldCrossValidation(data, folds);
+            std::printf("%d-fold cross-validation accuracy: %.4f (%.2f s)\n", folds, accuracy, seconds_since(start));
+        }
+
+        std::vector<std::vector<double>> train_data, test_data;
+        forest->set_seed(seed);
+        if (holdout > 0) {
+            // the split uses its own generator so the forest's seed stream is the same with or without a holdout
+            std::mt19937 split_rng(seed);
+            RandomForest::splitData(data, train_data, test_data, holdout, split_rng);
+        } else {
+            train_data = data;
+        }
+
+        start = std::chrono::steady_clock::now();
+        forest->train(train_data);
+        double train_seconds = seconds_since(start);
+        std::printf("Trained %d trees on %zu rows in %.2f s\n", num_trees, train_data.size(), train_seconds);
+
+        if (!test_data.empty()) {
+            // the flat forest scores the holdout in blocks, and importance substitutes permuted columns into those blocks
+            forest->set_inference_backend(RandomForest::SimdBackend);
+            start = std::chrono::steady_clock::now();
+            EvaluationReport report = evaluate_forest(*forest, test_data, RandomForest::LeafFrequency, 10, options.num_threads);
+            const ConfusionMatrix& votes = report.predicted;
+            std::printf("Holdout accuracy on %zu rows: %.2f%% (TP %zu, TN %zu, FP %zu, FN %zu) in %.2f s\n", test_data.size(), 100.0 * votes.accuracy(),
+                        votes.true_positives, votes.true_negatives, votes.false_positives, votes.false_negatives, seconds_since(start));
+            std::printf("Holdout ROC AUC %.4f, PR AUC %.4f, log-loss %.4f, Brier %.4f, calibration error %.4f\n", report.roc_auc, report.pr_auc,
+                        report.log_loss, report.brier, report.expected_calibration_error);
+            if (!metrics_path.empty()) {
+                std::ofstream out(metrics_path);
+                if (!out) throw std::runtime_error("Cannot write " + metrics_path);
+                report.write(out);
+            }
+        }
+
+        if (!importance_path.empty()) {
+            start = std::chrono::steady_clock::now();
+            std::vector<double> impurity = forest->impurity_importance();
+            PermutationImportance permutation;
+            if (!test_data.empty()) permutation = permutation_importance(*forest, test_data, importance_repeats, seed, options.num_threads);
+            const std::vector<std::string>& names = frame->get_feature_name_vec();
+            std::vector<size_t> order(impurity.size());
+            std::iota(order.begin(), order.end(), 0);
+            // most important first, by holdout Brier increase when there is a holdout
+            std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+                return test_data.empty() ? impurity[a] > impurity[b] : permutation.brier_increase[a] > permutation.brier_increase[b];
+            });
+            std::ofstream out(importance_path);
+            if (!out) throw std::runtime_error("Cannot write " + importance_path);
+            out << "feature,impurity_importance,permutation_accuracy_decrease,permutation_accuracy_stddev,permutation_brier_increase\n";
+            for (size_t f : order) {
+                out << names[f] << "," << impurity[f];
+                if (test_data.empty()) out << ",,,\n";
+                else out << "," << permutation.accuracy_decrease[f] << "," << permutation.accuracy_stddev[f] << "," << permutation.brier_increase[f] << "\n";
+            }
+            std::printf("Feature importance written to %s in %.2f s\n", importance_path.c_str(), seconds_since(start));
+        }
+
+        forest->save(model_path);
+        std::ofstream schema(schema_path);
+        if (!schema) throw std::runtime_error("Cannot write " + schema_path);
+        RowEncoder(*frame).save(schema);
+        std::cout << "Wrote " << model_path << " and " << schema_path << std::endl;
+
+        if (!instrumentation_path.empty()) {
+            std::ofstream report(instrumentation_path);
+            Instrumentation::global().write_json(report);
+        }
+        Logger::global().flush();
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}